@@ -32,6 +32,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <ctype.h>
+#include <pthread.h>
 #include <cutils/properties.h>
 #include <LocEngAdapter.h>
 #include "loc_eng_msg.h"
@@ -42,6 +43,49 @@
 
 using namespace loc_core;
 
+// A LocApi call made on the context MsgTask on behalf of another shard that
+// needs its result. The waiter is released when the message is deleted, so
+// a message dropped without running still wakes it, with -1.
+class LocEngApiWaiter {
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    bool mDone;
+    int mResult;
+public:
+    inline LocEngApiWaiter() : mDone(false), mResult(-1) {
+        pthread_mutex_init(&mLock, NULL);
+        pthread_cond_init(&mCond, NULL);
+    }
+    inline ~LocEngApiWaiter() {
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mLock);
+    }
+    inline void post(int result) {
+        pthread_mutex_lock(&mLock);
+        mResult = result;
+        mDone = true;
+        pthread_cond_signal(&mCond);
+        pthread_mutex_unlock(&mLock);
+    }
+    inline int wait() {
+        pthread_mutex_lock(&mLock);
+        while (!mDone) {
+            pthread_cond_wait(&mCond, &mLock);
+        }
+        pthread_mutex_unlock(&mLock);
+        return mResult;
+    }
+};
+
+struct LocEngApiCall : public LocMsg {
+    LocApiBase* mLocApi;
+    LocEngApiWaiter* mWaiter;
+    mutable int mResult;
+    inline LocEngApiCall(LocApiBase* locApi, LocEngApiWaiter* waiter) :
+        LocMsg(), mLocApi(locApi), mWaiter(waiter), mResult(-1) {}
+    inline virtual ~LocEngApiCall() { mWaiter->post(mResult); }
+};
+
 LocInternalAdapter::LocInternalAdapter(LocEngAdapter* adapter) :
     LocAdapterBase(adapter->getMsgTask()),
     mLocEngAdapter(adapter)
@@ -81,12 +125,22 @@ LocEngAdapter::LocEngAdapter(LOC_API_ADAPTER_EVENT_MASK_T mask,
 {
     memset(&mFixCriteria, 0, sizeof(mFixCriteria));
     mFixCriteria.mode = LOC_POSITION_MODE_INVALID;
+    // every shard delivers framework callbacks, so they need threads from
+    // the same creator as the context MsgTask
+    mShardTask[LOC_ENG_SHARD_CONTEXT] = NULL;
+    mShardTask[LOC_ENG_SHARD_POSITION] = new MsgTask(tCreator, "LocEngPosition");
+    mShardTask[LOC_ENG_SHARD_AGPS] = new MsgTask(tCreator, "LocEngAgps");
+    mShardTask[LOC_ENG_SHARD_CONFIG] = new MsgTask(tCreator, "LocEngConfig");
     LOC_LOGD("LocEngAdapter created");
 }
 
 inline
 LocEngAdapter::~LocEngAdapter()
 {
+    // joins the shard threads; anything still queued on them is dropped
+    for (int i = LOC_ENG_SHARD_CONTEXT + 1; i < LOC_ENG_SHARD_MAX; i++) {
+        mShardTask[i]->destroy();
+    }
     delete mInternalAdapter;
     LOC_LOGV("LocEngAdapter deleted");
 }
@@ -257,7 +311,7 @@ void LocEngAdapter::setXtraUserAgent() {
         }
     };
 
-    sendMsg(new LocSetXtraUserAgent(mContext));
+    sendMsg(new LocSetXtraUserAgent(mContext), LOC_ENG_SHARD_CONFIG);
 }
 
 void LocInternalAdapter::setUlpProxy(UlpProxyBase* ulp) {
@@ -328,6 +382,128 @@ int LocEngAdapter::setGpsLockMsg(LOC_GPS_LOCK_MASK lockMask)
     return 0;
 }
 
+enum loc_api_adapter_err
+LocEngAdapter::atlOpenStatus(int handle, int is_succ, char* apn,
+                             AGpsBearerType bearer, AGpsType agpsType)
+{
+    struct LocEngAdapterAtlOpenStatus : public LocMsg {
+        LocApiBase* mLocApi;
+        const int mHandle;
+        const int mIsSucc;
+        const bool mHasApn;
+        char mApn[MAX_APN_LEN + 1];
+        const AGpsBearerType mBearer;
+        const AGpsType mAgpsType;
+        inline LocEngAdapterAtlOpenStatus(LocApiBase* locApi, int handle, int isSucc,
+                                          const char* apn, AGpsBearerType bearer,
+                                          AGpsType agpsType) :
+            LocMsg(), mLocApi(locApi), mHandle(handle), mIsSucc(isSucc),
+            mHasApn(NULL != apn), mBearer(bearer), mAgpsType(agpsType)
+        {
+            mApn[0] = '\0';
+            if (mHasApn) {
+                strlcpy(mApn, apn, sizeof(mApn));
+            }
+            locallog();
+        }
+        inline virtual void proc() const {
+            mLocApi->atlOpenStatus(mHandle, mIsSucc, mHasApn ? (char*)mApn : NULL,
+                                   mBearer, mAgpsType);
+        }
+        inline void locallog() const {
+            LOC_LOGV("LocEngAdapterAtlOpenStatus - handle: %d, is_succ: %d",
+                     mHandle, mIsSucc);
+        }
+        inline virtual void log() const {
+            locallog();
+        }
+    };
+    sendMsg(new LocEngAdapterAtlOpenStatus(mLocApi, handle, is_succ, apn,
+                                           bearer, agpsType));
+    return LOC_API_ADAPTER_ERR_SUCCESS;
+}
+
+enum loc_api_adapter_err
+LocEngAdapter::atlCloseStatus(int handle, int is_succ)
+{
+    struct LocEngAdapterAtlCloseStatus : public LocMsg {
+        LocApiBase* mLocApi;
+        const int mHandle;
+        const int mIsSucc;
+        inline LocEngAdapterAtlCloseStatus(LocApiBase* locApi, int handle, int isSucc) :
+            LocMsg(), mLocApi(locApi), mHandle(handle), mIsSucc(isSucc)
+        {
+            locallog();
+        }
+        inline virtual void proc() const {
+            mLocApi->atlCloseStatus(mHandle, mIsSucc);
+        }
+        inline void locallog() const {
+            LOC_LOGV("LocEngAdapterAtlCloseStatus - handle: %d, is_succ: %d",
+                     mHandle, mIsSucc);
+        }
+        inline virtual void log() const {
+            locallog();
+        }
+    };
+    sendMsg(new LocEngAdapterAtlCloseStatus(mLocApi, handle, is_succ));
+    return LOC_API_ADAPTER_ERR_SUCCESS;
+}
+
+int LocEngAdapter::initDataServiceClient()
+{
+    struct LocEngAdapterInitDataClient : public LocEngApiCall {
+        inline LocEngAdapterInitDataClient(LocApiBase* locApi, LocEngApiWaiter* waiter) :
+            LocEngApiCall(locApi, waiter) {}
+        inline virtual void proc() const {
+            mResult = mLocApi->initDataServiceClient();
+        }
+    };
+    LocEngApiWaiter waiter;
+    sendMsg(new LocEngAdapterInitDataClient(mLocApi, &waiter));
+    return waiter.wait();
+}
+
+int LocEngAdapter::openAndStartDataCall()
+{
+    struct LocEngAdapterStartDataCall : public LocEngApiCall {
+        inline LocEngAdapterStartDataCall(LocApiBase* locApi, LocEngApiWaiter* waiter) :
+            LocEngApiCall(locApi, waiter) {}
+        inline virtual void proc() const {
+            mResult = mLocApi->openAndStartDataCall();
+        }
+    };
+    LocEngApiWaiter waiter;
+    sendMsg(new LocEngAdapterStartDataCall(mLocApi, &waiter));
+    return waiter.wait();
+}
+
+void LocEngAdapter::stopDataCall()
+{
+    struct LocEngAdapterStopDataCall : public LocMsg {
+        LocApiBase* mLocApi;
+        inline LocEngAdapterStopDataCall(LocApiBase* locApi) :
+            LocMsg(), mLocApi(locApi) {}
+        inline virtual void proc() const {
+            mLocApi->stopDataCall();
+        }
+    };
+    sendMsg(new LocEngAdapterStopDataCall(mLocApi));
+}
+
+void LocEngAdapter::closeDataCall()
+{
+    struct LocEngAdapterCloseDataCall : public LocMsg {
+        LocApiBase* mLocApi;
+        inline LocEngAdapterCloseDataCall(LocApiBase* locApi) :
+            LocMsg(), mLocApi(locApi) {}
+        inline virtual void proc() const {
+            mLocApi->closeDataCall();
+        }
+    };
+    sendMsg(new LocEngAdapterCloseDataCall(mLocApi));
+}
+
 void LocEngAdapter::requestPowerVote()
 {
     if (getPowerVoteRight()) {
@@ -349,12 +525,13 @@ void LocInternalAdapter::reportPosition(UlpLocation &location,
                                         enum loc_sess_status status,
                                         LocPosTechMask loc_technology_mask)
 {
-    sendMsg(new LocEngReportPosition(mLocEngAdapter,
-                                     location,
-                                     locationExtended,
-                                     locationExt,
-                                     status,
-                                     loc_technology_mask));
+    mLocEngAdapter->sendMsg(new LocEngReportPosition(mLocEngAdapter,
+                                                     location,
+                                                     locationExtended,
+                                                     locationExt,
+                                                     status,
+                                                     loc_technology_mask),
+                            LOC_ENG_SHARD_POSITION);
 }
 
 
@@ -380,8 +557,9 @@ void LocEngAdapter::reportPosition(UlpLocation &location,
 void LocInternalAdapter::reportSv(HaxxSvStatus &svStatus,
                                   GpsLocationExtended &locationExtended,
                                   void* svExt){
-    sendMsg(new LocEngReportSv(mLocEngAdapter, svStatus,
-                               locationExtended, svExt));
+    mLocEngAdapter->sendMsg(new LocEngReportSv(mLocEngAdapter, svStatus,
+                                               locationExtended, svExt),
+                            LOC_ENG_SHARD_POSITION);
 }
 
 void LocEngAdapter::reportSv(HaxxSvStatus &svStatus,
@@ -408,7 +586,8 @@ void LocEngAdapter::setInSession(bool inSession)
 
 void LocInternalAdapter::reportStatus(GpsStatusValue status)
 {
-    sendMsg(new LocEngReportStatus(mLocEngAdapter, status));
+    mLocEngAdapter->sendMsg(new LocEngReportStatus(mLocEngAdapter, status),
+                            LOC_ENG_SHARD_POSITION);
 }
 
 void LocEngAdapter::reportStatus(GpsStatusValue status)
@@ -420,7 +599,9 @@ void LocEngAdapter::reportStatus(GpsStatusValue status)
 
 void LocInternalAdapter::reportNmea(const char* nmea, int length)
 {
-    sendMsg(new LocEngReportNmea(mLocEngAdapter->getOwner(), nmea, length));
+    mLocEngAdapter->sendMsg(new LocEngReportNmea(mLocEngAdapter->getOwner(),
+                                                 nmea, length),
+                            LOC_ENG_SHARD_POSITION);
 }
 
 inline void LocEngAdapter::reportNmea(const char* nmea, int length)
@@ -439,7 +620,8 @@ bool LocEngAdapter::reportXtraServer(const char* url1,
 {
     if (mSupportsAgpsRequests) {
         sendMsg(new LocEngReportXtraServer(mOwner, url1,
-                                           url2, url3, maxlength));
+                                           url2, url3, maxlength),
+                LOC_ENG_SHARD_CONFIG);
     }
     return mSupportsAgpsRequests;
 }
@@ -449,7 +631,8 @@ bool LocEngAdapter::requestATL(int connHandle, AGpsType agps_type)
 {
     if (mSupportsAgpsRequests) {
         sendMsg(new LocEngRequestATL(mOwner,
-                                     connHandle, agps_type));
+                                     connHandle, agps_type),
+                LOC_ENG_SHARD_AGPS);
     }
     return mSupportsAgpsRequests;
 }
@@ -458,7 +641,7 @@ inline
 bool LocEngAdapter::releaseATL(int connHandle)
 {
     if (mSupportsAgpsRequests) {
-        sendMsg(new LocEngReleaseATL(mOwner, connHandle));
+        sendMsg(new LocEngReleaseATL(mOwner, connHandle), LOC_ENG_SHARD_AGPS);
     }
     return mSupportsAgpsRequests;
 }
@@ -467,7 +650,7 @@ inline
 bool LocEngAdapter::requestXtraData()
 {
     if (mSupportsAgpsRequests) {
-        sendMsg(new LocEngRequestXtra(mOwner));
+        sendMsg(new LocEngRequestXtra(mOwner), LOC_ENG_SHARD_CONFIG);
     }
     return mSupportsAgpsRequests;
 }
@@ -476,7 +659,7 @@ inline
 bool LocEngAdapter::requestTime()
 {
     if (mSupportsAgpsRequests) {
-        sendMsg(new LocEngRequestTime(mOwner));
+        sendMsg(new LocEngRequestTime(mOwner), LOC_ENG_SHARD_CONFIG);
     }
     return mSupportsAgpsRequests;
 }
@@ -488,7 +671,7 @@ bool LocEngAdapter::requestNiNotify(GpsNiNotification &notif, const void* data)
         notif.size = sizeof(notif);
         notif.timeout = LOC_NI_NO_RESPONSE_TIME;
 
-        sendMsg(new LocEngRequestNi(mOwner, notif, data));
+        sendMsg(new LocEngRequestNi(mOwner, notif, data), LOC_ENG_SHARD_CONFIG);
     }
     return mSupportsAgpsRequests;
 }
@@ -497,7 +680,7 @@ inline
 bool LocEngAdapter::requestSuplES(int connHandle)
 {
     if (mSupportsAgpsRequests)
-        sendMsg(new LocEngRequestSuplEs(mOwner, connHandle));
+        sendMsg(new LocEngRequestSuplEs(mOwner, connHandle), LOC_ENG_SHARD_AGPS);
     return mSupportsAgpsRequests;
 }
 
@@ -505,7 +688,7 @@ inline
 bool LocEngAdapter::reportDataCallOpened()
 {
     if(mSupportsAgpsRequests)
-        sendMsg(new LocEngSuplEsOpened(mOwner));
+        sendMsg(new LocEngSuplEsOpened(mOwner), LOC_ENG_SHARD_AGPS);
     return mSupportsAgpsRequests;
 }
 
@@ -513,7 +696,7 @@ inline
 bool LocEngAdapter::reportDataCallClosed()
 {
     if(mSupportsAgpsRequests)
-        sendMsg(new LocEngSuplEsClosed(mOwner));
+        sendMsg(new LocEngSuplEsClosed(mOwner), LOC_ENG_SHARD_AGPS);
     return mSupportsAgpsRequests;
 }
 
@@ -576,7 +759,8 @@ enum loc_api_adapter_err LocEngAdapter::setXtraVersionCheck(int check)
 void LocEngAdapter::reportGpsMeasurementData(GpsData &gpsMeasurementData)
 {
     sendMsg(new LocEngReportGpsMeasurement(mOwner,
-                                           gpsMeasurementData));
+                                           gpsMeasurementData),
+            LOC_ENG_SHARD_POSITION);
 }
 
 /*
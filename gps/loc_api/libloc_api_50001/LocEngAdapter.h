@@ -69,6 +69,25 @@ public:
 
 typedef void (*loc_msg_sender)(void* loc_eng_data_p, void* msgp);
 
+// Each shard is a MsgTask of its own. Messages keep their order within a
+// shard, while shards run independently of one another, so a framework
+// callback or an AGPS state machine never holds up fix delivery. Anything
+// that calls into LocApi runs on the context MsgTask, behind LocOpenMsg
+// and LocSsrMsg.
+enum LocEngMsgShard {
+    // session control and every LocApi call; this is the context MsgTask,
+    // shared with LocApiBase and LocInternalAdapter
+    LOC_ENG_SHARD_CONTEXT = 0,
+    // position, SV, NMEA, status and measurement reports; these only call
+    // framework callbacks and post their LocApi work back to the context
+    LOC_ENG_SHARD_POSITION,
+    // ATL / DS / WIFI state machines; their LocApi calls are posted back
+    LOC_ENG_SHARD_AGPS,
+    // framework requests: XTRA download, time, NI dialogs
+    LOC_ENG_SHARD_CONFIG,
+    LOC_ENG_SHARD_MAX
+};
+
 class LocEngAdapter : public LocAdapterBase {
     void* mOwner;
     LocInternalAdapter* mInternalAdapter;
@@ -81,6 +100,8 @@ class LocEngAdapter : public LocAdapterBase {
     unsigned int mPowerVote;
     static const unsigned int POWER_VOTE_RIGHT = 0x20;
     static const unsigned int POWER_VOTE_VALUE = 0x10;
+    // owned; the LOC_ENG_SHARD_CONTEXT slot is unused, that is mMsgTask
+    MsgTask* mShardTask[LOC_ENG_SHARD_MAX];
 
 public:
     bool mSupportsAgpsRequests;
@@ -108,6 +129,11 @@ public:
     }
     inline const MsgTask* getMsgTask() { return mMsgTask; }
 
+    using LocAdapterBase::sendMsg;
+    inline void sendMsg(const LocMsg* msg, LocEngMsgShard shard) const {
+        (LOC_ENG_SHARD_CONTEXT == shard ? mMsgTask : mShardTask[shard])->sendMsg(msg);
+    }
+
     inline enum loc_api_adapter_err
         startFix()
     {
@@ -148,16 +174,11 @@ public:
     {
         return mLocApi->requestXtraServer();
     }
-    inline enum loc_api_adapter_err
-        atlOpenStatus(int handle, int is_succ, char* apn, AGpsBearerType bearer, AGpsType agpsType)
-    {
-        return mLocApi->atlOpenStatus(handle, is_succ, apn, bearer, agpsType);
-    }
-    inline enum loc_api_adapter_err
-        atlCloseStatus(int handle, int is_succ)
-    {
-        return mLocApi->atlCloseStatus(handle, is_succ);
-    }
+    // called from the AGPS shard; queued to the context MsgTask
+    enum loc_api_adapter_err
+        atlOpenStatus(int handle, int is_succ, char* apn, AGpsBearerType bearer, AGpsType agpsType);
+    enum loc_api_adapter_err
+        atlCloseStatus(int handle, int is_succ);
     inline enum loc_api_adapter_err
         setPositionMode(const LocPosMode *posMode)
     {
@@ -232,22 +253,11 @@ public:
     {
         return mLocApi->setAGLONASSProtocol(aGlonassProtocol);
     }
-    inline virtual int initDataServiceClient()
-    {
-        return mLocApi->initDataServiceClient();
-    }
-    inline virtual int openAndStartDataCall()
-    {
-        return mLocApi->openAndStartDataCall();
-    }
-    inline virtual void stopDataCall()
-    {
-        mLocApi->stopDataCall();
-    }
-    inline virtual void closeDataCall()
-    {
-        mLocApi->closeDataCall();
-    }
+    // called off the context MsgTask; the first two wait for the result
+    virtual int initDataServiceClient();
+    virtual int openAndStartDataCall();
+    virtual void stopDataCall();
+    virtual void closeDataCall();
     inline enum loc_api_adapter_err
         getZpp(GpsLocation &zppLoc, LocPosTechMask &tech_mask)
     {
@@ -178,6 +178,14 @@ static const GnssConfigurationInterface sLocEngConfigInterface =
     loc_configuration_update
 };
 
+static size_t loc_get_internal_state(char* buffer, size_t bufferSize);
+
+static const GpsDebugInterface sLocEngDebugInterface =
+{
+    sizeof(GpsDebugInterface),
+    loc_get_internal_state
+};
+
 static loc_eng_data_s_type loc_afw_data;
 static int gss_fd = -1;
 static int sGnssType = GNSS_UNKNOWN;
@@ -643,6 +651,10 @@ const void* loc_get_extension(const char* name)
    {
        ret_val = &sLocEngGpsMeasurementInterface;
    }
+   else if (strcmp(name, GPS_DEBUG_INTERFACE) == 0)
+   {
+       ret_val = &sLocEngDebugInterface;
+   }
    else
    {
       LOC_LOGE ("get_extension: Invalid interface passed in\n");
@@ -1059,6 +1071,14 @@ static void loc_configuration_update(const char* config_data, int32_t length)
     EXIT_LOG(%s, VOID_RET);
 }
 
+static size_t loc_get_internal_state(char* buffer, size_t bufferSize)
+{
+    ENTRY_LOG();
+    size_t ret_val = loc_eng_get_internal_state(buffer, bufferSize);
+    EXIT_LOG(%zu, ret_val);
+    return ret_val;
+}
+
 static void local_loc_cb(UlpLocation* location, void* locExt)
 {
     ENTRY_LOG();
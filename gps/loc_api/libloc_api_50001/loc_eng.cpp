@@ -34,6 +34,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <dlfcn.h>
 #include <ctype.h>
 #include <math.h>
@@ -67,6 +68,7 @@
 #include <loc_eng_msg.h>
 #include <loc_eng_nmea.h>
 #include <msg_q.h>
+#include <loc_timer.h>
 #include <loc.h>
 #include "log_util.h"
 #include "platform_lib_includes.h"
@@ -112,6 +114,7 @@ static const loc_param_s_type gps_conf_table[] =
   {"LONGTERM_PSDS_SERVER_2",                  &gps_conf.LONGTERM_PSDS_SERVER_2,                  NULL, 's'},
   {"LONGTERM_PSDS_SERVER_3",                  &gps_conf.LONGTERM_PSDS_SERVER_3,                  NULL, 's'},
   {"USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL",  &gps_conf.USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL,          NULL, 'n'},
+  {"TIMER_SLACK_MSEC",               &gps_conf.TIMER_SLACK_MSEC,               NULL, 'n'},
 };
 
 static const loc_param_s_type sap_conf_table[] =
@@ -154,6 +157,8 @@ static void loc_default_parameters(void)
    gps_conf.XTRA_VERSION_CHECK=0;
    /*Use emergency PDN by default*/
    gps_conf.USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL = 1;
+   /*Timers fire at their exact timeout by default*/
+   gps_conf.TIMER_SLACK_MSEC = 0;
 
    /*Defaults for sap.conf*/
    sap_conf.GYRO_BIAS_RANDOM_WALK = 0;
@@ -724,6 +729,53 @@ struct LocEngExtPowerConfig : public LocMsg {
     }
 };
 
+// Runs on the context for a singleshot fix that has been reported from
+// the position shard.
+struct LocEngSingleShotDone : public LocMsg {
+    LocEngAdapter* mAdapter;
+    const bool mStopFix;
+    inline LocEngSingleShotDone(LocEngAdapter* adapter, bool stopFix) :
+        LocMsg(), mAdapter(adapter), mStopFix(stopFix)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        if (mStopFix) {
+            // modem could be still working for a final fix,
+            // although we no longer need it.  So stopFix().
+            mAdapter->stopFix();
+        }
+        // turn off the session flag.
+        mAdapter->setInSession(false);
+    }
+    inline void locallog() const {
+        LOC_LOGV("LocEngSingleShotDone - stopFix: %d", mStopFix);
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
+// Runs on the context after a status report, so that aiding data deletion
+// deferred while the engine was on goes to LocApi once it is off.
+struct LocEngUpdateAidData : public LocMsg {
+    loc_eng_data_s_type* mLocEng;
+    inline LocEngUpdateAidData(loc_eng_data_s_type* locEng) :
+        LocMsg(), mLocEng(locEng)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        update_aiding_data_for_deletion(*mLocEng);
+    }
+    inline void locallog() const {
+        LOC_LOGV("LocEngUpdateAidData");
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
 //        case LOC_ENG_MSG_REPORT_POSITION:
 LocEngReportPosition::LocEngReportPosition(LocAdapterBase* adapter,
                                            UlpLocation &loc,
@@ -784,13 +836,10 @@ void LocEngReportPosition::proc() const {
             // and if this is a singleshot
             GPS_POSITION_RECURRENCE_SINGLE ==
             locEng->adapter->getPositionMode().recurrence) {
-            if (LOC_SESS_INTERMEDIATE == mStatus) {
-                // modem could be still working for a final fix,
-                // although we no longer need it.  So stopFix().
-                locEng->adapter->stopFix();
-            }
-            // turn off the session flag.
-            locEng->adapter->setInSession(false);
+            // both calls go into LocApi, so they run on the context
+            locEng->adapter->sendMsg(
+                new LocEngSingleShotDone(locEng->adapter,
+                                         LOC_SESS_INTERMEDIATE == mStatus));
         }
 
         LOC_LOGV("LocEngReportPosition::proc() - generateNmea: %d, position source: %d, "
@@ -824,7 +873,7 @@ void LocEngReportPosition::log() const {
     locallog();
 }
 void LocEngReportPosition::send() const {
-    mAdapter->sendMsg(this);
+    ((LocEngAdapter*)mAdapter)->sendMsg(this, LOC_ENG_SHARD_POSITION);
 }
 
 
@@ -865,7 +914,7 @@ inline void LocEngReportSv::log() const {
     locallog();
 }
 void LocEngReportSv::send() const {
-    mAdapter->sendMsg(this);
+    ((LocEngAdapter*)mAdapter)->sendMsg(this, LOC_ENG_SHARD_POSITION);
 }
 
 //        case LOC_ENG_MSG_REPORT_STATUS:
@@ -881,7 +930,9 @@ inline void LocEngReportStatus::proc() const
     loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)adapter->getOwner();
 
     loc_eng_report_status(*locEng, mStatus);
-    update_aiding_data_for_deletion(*locEng);
+    if (mStatus == GPS_STATUS_ENGINE_OFF) {
+        adapter->sendMsg(new LocEngUpdateAidData(locEng));
+    }
 }
 inline void LocEngReportStatus::locallog() const {
     LOC_LOGV("LocEngReportStatus");
@@ -1014,7 +1065,7 @@ inline void LocEngReqRelBIT::log() const {
 }
 void LocEngReqRelBIT::send() const {
     loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)mLocEng;
-    locEng->adapter->sendMsg(this);
+    locEng->adapter->sendMsg(this, LOC_ENG_SHARD_AGPS);
 }
 
 //        case LOC_ENG_MSG_RELEASE_BIT:
@@ -1238,7 +1289,7 @@ inline void LocEngReqRelWifi::log() const {
 }
 void LocEngReqRelWifi::send() const {
     loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)mLocEng;
-    locEng->adapter->sendMsg(this);
+    locEng->adapter->sendMsg(this, LOC_ENG_SHARD_AGPS);
 }
 
 //        case LOC_ENG_MSG_REQUEST_XTRA_DATA:
@@ -1534,6 +1585,30 @@ struct LocEngDataClientInit : public LocMsg {
     }
 };
 
+// ATL state machines are only ever touched from the AGPS shard, so the
+// engine up path hands their reset over rather than doing it inline
+struct LocEngAgpsReinit : public LocMsg {
+    loc_eng_data_s_type* mLocEng;
+    inline LocEngAgpsReinit(loc_eng_data_s_type* locEng) :
+        LocMsg(), mLocEng(locEng) {
+        locallog();
+    }
+    virtual void proc() const {
+        if (mLocEng->agnss_nif)
+            mLocEng->agnss_nif->dropAllSubscribers();
+        if (mLocEng->internet_nif)
+            mLocEng->internet_nif->dropAllSubscribers();
+
+        loc_eng_agps_reinit(*mLocEng);
+    }
+    void locallog() const {
+        LOC_LOGV("LocEngAgpsReinit\n");
+    }
+    virtual void log() const {
+        locallog();
+    }
+};
+
 struct LocEngInstallAGpsCert : public LocMsg {
     LocEngAdapter* mpAdapter;
     const size_t mNumberOfCerts;
@@ -2316,7 +2391,8 @@ void loc_eng_agps_init(loc_eng_data_s_type &loc_eng_data, AGpsExtCallbacks* call
 
         if (adapter->mSupportsAgpsRequests) {
             if(gps_conf.USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL) {
-                loc_eng_data.adapter->sendMsg(new LocEngDataClientInit(&loc_eng_data));
+                loc_eng_data.adapter->sendMsg(new LocEngDataClientInit(&loc_eng_data),
+                                              LOC_ENG_SHARD_AGPS);
             }
             loc_eng_dmn_conn_loc_api_server_launch(callbacks->create_thread_cb,
                                                    NULL, NULL, &loc_eng_data);
@@ -2396,7 +2472,8 @@ int loc_eng_agps_open(loc_eng_data_s_type &loc_eng_data, AGpsExtType agpsType,
     AgpsStateMachine* sm = getAgpsStateMachine(loc_eng_data, agpsType);
 
     loc_eng_data.adapter->sendMsg(
-        new LocEngAtlOpenSuccess(sm, apn, apn_len, bearerType));
+        new LocEngAtlOpenSuccess(sm, apn, apn_len, bearerType),
+        LOC_ENG_SHARD_AGPS);
 
     EXIT_LOG(%d, 0);
     return 0;
@@ -2426,7 +2503,7 @@ int loc_eng_agps_closed(loc_eng_data_s_type &loc_eng_data, AGpsExtType agpsType)
                return -1);
 
     AgpsStateMachine* sm = getAgpsStateMachine(loc_eng_data, agpsType);
-    loc_eng_data.adapter->sendMsg(new LocEngAtlClosed(sm));
+    loc_eng_data.adapter->sendMsg(new LocEngAtlClosed(sm), LOC_ENG_SHARD_AGPS);
 
     EXIT_LOG(%d, 0);
     return 0;
@@ -2456,7 +2533,7 @@ int loc_eng_agps_open_failed(loc_eng_data_s_type &loc_eng_data, AGpsExtType agps
                return -1);
 
     AgpsStateMachine* sm = getAgpsStateMachine(loc_eng_data, agpsType);
-    loc_eng_data.adapter->sendMsg(new LocEngAtlOpenFailed(sm));
+    loc_eng_data.adapter->sendMsg(new LocEngAtlOpenFailed(sm), LOC_ENG_SHARD_AGPS);
 
     EXIT_LOG(%d, 0);
     return 0;
@@ -2847,13 +2924,11 @@ void loc_eng_handle_engine_up(loc_eng_data_s_type &loc_eng_data)
 
     loc_eng_data.adapter->requestPowerVote();
 
+    // queued ahead of the restart below, so ATL requests for the new
+    // session reach the state machines only after they are reset
     if (loc_eng_data.agps_status_cb != NULL) {
-        if (loc_eng_data.agnss_nif)
-            loc_eng_data.agnss_nif->dropAllSubscribers();
-        if (loc_eng_data.internet_nif)
-            loc_eng_data.internet_nif->dropAllSubscribers();
-
-        loc_eng_agps_reinit(loc_eng_data);
+        loc_eng_data.adapter->sendMsg(new LocEngAgpsReinit(&loc_eng_data),
+                                      LOC_ENG_SHARD_AGPS);
     }
 
     // modem is back up.  If we crashed in the middle of navigating, we restart.
@@ -2915,6 +2990,10 @@ int loc_eng_read_config(void)
       // In fact one day the conf file should go into context.
       UTIL_READ_CONF(GPS_CONF_FILE, gps_conf_table);
       UTIL_READ_CONF(SAP_CONF_FILE, sap_conf_table);
+      if (gps_conf.TIMER_SLACK_MSEC) {
+          loc_timer_set_slack(gps_conf.TIMER_SLACK_MSEC, false);
+          loc_timer_set_slack(gps_conf.TIMER_SLACK_MSEC, true);
+      }
       configAlreadyRead = true;
     } else {
       LOC_LOGV("GPS Config file has already been read\n");
@@ -3000,3 +3079,53 @@ void loc_eng_gps_measurement_close(loc_eng_data_s_type &loc_eng_data)
     loc_eng_data.gps_measurement_cb = NULL;
     EXIT_LOG(%d, 0);
 }
+
+/*===========================================================================
+FUNCTION    loc_eng_get_internal_state
+
+DESCRIPTION
+   Fills buffer with the statistics of the HAL's timers and alarms, as
+   dumped by loc_timer_dump_stats(), for GPS_DEBUG_INTERFACE.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Number of bytes written to buffer, without the terminating NUL
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+size_t loc_eng_get_internal_state(char* buffer, size_t bufferSize)
+{
+    ENTRY_LOG_CALLFLOW();
+    size_t len = 0;
+    int fds[2];
+
+    if (NULL == buffer || 0 == bufferSize) {
+        return 0;
+    }
+
+    // the dump is well under a pipe buffer, so it can be written in full
+    // before it is read
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        LOC_LOGE("%s: pipe2 failed, errno %d", __func__, errno);
+        return 0;
+    }
+    loc_timer_dump_stats(fds[1]);
+    close(fds[1]);
+
+    while (len < bufferSize - 1) {
+        ssize_t n = TEMP_FAILURE_RETRY(read(fds[0], buffer + len, bufferSize - 1 - len));
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+    close(fds[0]);
+    buffer[len] = '\0';
+
+    EXIT_LOG(%zu, len);
+    return len;
+}
@@ -162,6 +162,7 @@ typedef struct loc_gps_cfg_s
     uint32_t       GPS_LOCK;
     uint32_t       A_GLONASS_POS_PROTOCOL_SELECT;
     uint32_t       AGPS_CERT_WRITABLE_MASK;
+    uint32_t       TIMER_SLACK_MSEC;
 } loc_gps_cfg_s_type;
 
 /* NOTE: the implementaiton of the parser casts number
@@ -264,6 +265,7 @@ void loc_eng_configuration_update (loc_eng_data_s_type &loc_eng_data,
 int loc_eng_gps_measurement_init(loc_eng_data_s_type &loc_eng_data,
                                  GpsMeasurementCallbacks* callbacks);
 void loc_eng_gps_measurement_close(loc_eng_data_s_type &loc_eng_data);
+size_t loc_eng_get_internal_state(char* buffer, size_t bufferSize);
 
 #ifdef __cplusplus
 }
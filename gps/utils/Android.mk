@@ -13,6 +13,7 @@ LOCAL_SRC_FILES += \
     loc_log.cpp \
     loc_cfg.cpp \
     msg_q.c \
+    msg_ring.c \
     linked_list.c \
     loc_target.cpp \
     platform_lib_abstractions/elapsed_millis_since_boot.cpp \
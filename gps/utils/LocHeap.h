@@ -32,9 +32,18 @@
 #include <stddef.h>
 #include <string.h>
 
+// index of a LocRankable obj that is not currently in any heap
+#define LOC_HEAP_INVALID_INDEX ((size_t)-1)
+
 // abstract class to be implemented by client to provide a rankable class
 class LocRankable {
+    friend class LocHeap;
+    // position of this obj in the array of the heap that holds it, so that
+    // the heap can find it without searching. LOC_HEAP_INVALID_INDEX if the
+    // obj is not in a heap. An obj can only be in one heap at a time.
+    size_t mHeapIndex;
 public:
+    inline LocRankable() : mHeapIndex(LOC_HEAP_INVALID_INDEX) {}
     virtual inline ~LocRankable() {}
 
     // method to rank objects of such type for sorting purposes.
@@ -48,45 +57,62 @@ public:
     inline bool outRanks(LocRankable& rankable) { return ranks(rankable) > 0; }
 };
 
-// opaque class to provide service implementation.
-class LocHeapNode;
-
-// a heap whose left and right children are not sorted. It is sorted only vertically,
-// i.e. parent always ranks higher than children, if they exist. Ranking algorithm is
-// implemented in Rankable. The reason that there is no sort between children is to
-// help beter balance the tree with lower cost. When a node is pushed to the tree,
-// it is guaranteed that the subtree that is smaller gets to have the new node.
+// a binary heap kept in a contiguous array of pointers to the client objs.
+// The children of the node at index i are at 2i+1 and 2i+2, and a parent
+// always ranks higher than its children. Ranking algorithm is implemented
+// in Rankable. Each obj carries its own index in the array, so that remove()
+// does not need to search the heap. push / pop / remove are all O(log n),
+// none of them allocate per node, and none of them recurse. The array only
+// grows, by doubling, when it is full.
 class LocHeap {
 protected:
-    LocHeapNode* mTree;
+    LocRankable** mNodes;
+    size_t mSize;
+    size_t mCapacity;
+
+    // move the node at index up / down until the heap is sorted again.
+    // Returns the final index of the node.
+    size_t siftUp(size_t index);
+    size_t siftDown(size_t index);
+    // store node at index and update its back index
+    inline void place(LocRankable* node, size_t index) {
+        mNodes[index] = node;
+        node->mHeapIndex = index;
+    }
+    // take out the node at index, filling the hole with the last node
+    LocRankable* removeAt(size_t index);
+    // checks that the back indices are correct, AND that each node ranks
+    // no higher than its parent
+    bool checkNodes();
 public:
-    inline LocHeap() : mTree(NULL) {}
+    inline LocHeap() : mNodes(NULL), mSize(0), mCapacity(0) {}
     ~LocHeap();
 
-    // push keeps the tree sorted by rank, it also tries to balance the
-    // tree by adding the new node to the smaller of the subtrees.
+    // push keeps the heap sorted by rank.
     // node is reference to an obj that is managed by client, that client
     //      creates and destroyes. The destroy should happen after the
     //      node is popped out from the heap.
-    void push(LocRankable& node);
+    // Returns false if the array could not grow, in which case the node is
+    //         not in the heap.
+    bool push(LocRankable& node);
 
-    // Peeks the node data on tree top, which has currently the highest ranking
-    // There is no change the tree structure with this operation
-    // Returns NULL if the tree is empty, otherwise pointer to the node data of
-    //         the tree top.
-    LocRankable* peek();
+    // Peeks the node data on heap top, which has currently the highest ranking
+    // There is no change the heap structure with this operation
+    // Returns NULL if the heap is empty, otherwise pointer to the node data of
+    //         the heap top.
+    inline LocRankable* peek() { return mSize ? mNodes[0] : NULL; }
 
-    // pop keeps the tree sorted by rank, but it does not try to balance
-    // the tree.
+    // pop keeps the heap sorted by rank.
     // Return - pointer to the node popped out, or NULL if heap is already empty
     LocRankable* pop();
 
-    // navigating through the tree and find the node that ranks the same
-    // as the input data, then remove it from the tree. Rank is implemented
-    // by rankable obj.
-    // returns the pointer to the node removed; or NULL (if failed).
+    // remove the input obj from the heap, using the index the obj carries.
+    // returns the pointer to the node removed; or NULL (if it is not in
+    // this heap).
     LocRankable* remove(LocRankable& rankable);
 
+    inline size_t size() { return mSize; }
+
 #ifdef __LOC_UNIT_TEST__
     bool checkTree();
     uint32_t getTreeSize();
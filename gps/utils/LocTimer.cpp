@@ -29,6 +29,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
 #include <errno.h>
 #include <loc_timer.h>
@@ -47,8 +48,9 @@
 #endif
 
 /*
-There are implementations of 5 classes in this file:
-LocTimer, LocTimerDelegate, LocTimerContainer, LocTimerPollTask, LocTimerWrapper
+There are implementations of 6 classes in this file:
+LocTimer, LocTimerDelegate, LocTimerContainer, LocTimerWheel, LocTimerPollTask,
+LocTimerWrapper
 
 LocTimer - client front end, interface for client to start / stop timers, also
            to provide a callback.
@@ -70,6 +72,9 @@ LocTimerContainer - core of the timer service. It is a container (derived from
                     provided by LocTimerPollTask. All the heap management on the
                     LocTimerDelegate objs are done in the MsgTask context, such
                     that synchronization is ensured.
+LocTimerWheel - optional backend of LocTimerContainer, used instead of the heap
+                when a slack is configured for the container. It coalesces
+                timers that are due within the same tick of slack length.
 LocTimerPollTask - is a class that wraps timerfd and epoll POXIS APIs. It also
                    both implements LocRunnalbe with epoll_wait() in the run()
                    method. It is also a LocThread client, so as to loop the run
@@ -80,6 +85,17 @@ LocTimerWrapper - a LocTimer client itself, to implement the existing C API with
 */
 
 class LocTimerPollTask;
+class LocTimerWheel;
+
+static inline uint64_t timespecToNs(const struct timespec& ts) {
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline uint64_t getBootTimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return timespecToNs(now);
+}
 
 // This is a multi-functaional class that:
 // * extends the LocHeap class for the detection of head update upon add / remove
@@ -100,8 +116,19 @@ class LocTimerContainer : public LocHeap {
     static MsgTask* mMsgTask;
     // Poll task to provide epoll call and threading to poll.
     static LocTimerPollTask* mPollTask;
+    // slack configured for timers / alarms, in ms. 0 if none.
+    static uint32_t mSwSlackInMs;
+    static uint32_t mHwSlackInMs;
     // timer / alarm fd
     int mDevFd;
+    // timer wheel the timers are kept in when there is a slack, in which
+    // case the heap stays empty. NULL if there is no slack.
+    LocTimerWheel* mWheel;
+    // slot boundary the fd is armed at in wheel mode, 0 if disarmed
+    uint64_t mArmedNs;
+    // statistics, guarded by mStatsMutex as they can be read from any thread
+    pthread_mutex_t mStatsMutex;
+    LocTimerStats mStats;
     // ctor
     LocTimerContainer(bool wakeOnExpire);
     // dtor
@@ -112,10 +139,30 @@ class LocTimerContainer : public LocHeap {
     LocTimerDelegate* popIfOutRanks(LocTimerDelegate& timer);
     // update the timer POSIX calls with updated soonest timer spec
     void updateSoonestTime(LocTimerDelegate* priorTop);
+    // wheel mode version of the above, re-arming only if the slot boundary
+    // of the soonest timer changed
+    void updateWheelTime();
+    // move all the timers into a wheel with ticks of slackInMs, or back to
+    // the heap if slackInMs is 0
+    void switchBackend(uint32_t slackInMs);
+    // number of timers running, in the heap or the wheel
+    size_t getDepth();
+    // statistics updates
+    void noteRearm();
+    void noteWakeup();
+    void noteStart();
+    void noteStop();
+    void noteBatch(uint64_t wakeNs, uint64_t startNs, uint32_t count);
+    void copyStats(LocTimerStats& stats, bool reset);
 
 public:
     // factory method to control the creation of mSwTimers / mHwTimers
     static LocTimerContainer* get(bool wakeOnExpire);
+    // configure the slack of mSwTimers / mHwTimers, now or upon creation
+    static void setSlack(uint32_t slackInMs, bool wakeOnExpire);
+    // statistics of mSwTimers / mHwTimers, false if not created
+    static bool getStats(bool wakeOnExpire, LocTimerStats& stats, bool reset);
+    static void dumpStats(int fd);
 
     LocTimerDelegate* getSoonestTimer();
     int getTimerFd();
@@ -123,8 +170,10 @@ public:
     void add(LocTimerDelegate& timer);
     // remove a timer / alarm obj from the container
     void remove(LocTimerDelegate& timer);
-    // handling of timer / alarm expiration
-    void expire();
+    // handling of timer / alarm expiration, the poll thread woke up at wakeNs
+    void expire(uint64_t wakeNs);
+    // statistics of a timer callback called by LocTimerDelegate::expire()
+    void noteExpiry(uint64_t dueNs, uint64_t wakeNs, uint64_t startNs, uint64_t endNs);
 };
 
 // This class implements the polling thread that epolls imer / alarm fds.
@@ -167,27 +216,87 @@ public:
     virtual bool run();
 };
 
+// A hierarchical timer wheel. Time is cut into ticks of the slack length,
+// counted from the start of CLOCK_BOOTTIME, and a timer is due on the first
+// tick boundary at or after its mFutureTime, so all the timers falling in
+// the same tick expire together. Level 0 has a slot per tick; a slot of
+// level N spans all the slots of level N-1, and gets cascaded down into the
+// lower levels when its time comes. Timers too far out for the top level
+// park in its furthest slot and get placed again on cascade. Each slot is
+// a doubly linked list of LocTimerDelegate objs, so add / remove are O(1),
+// and the occupancy bitmaps find the next busy slot without walking slots.
+// It is only accessed in the MsgTask context.
+class LocTimerWheel {
+    static const int kLevels = 4;
+    static const int kSlotBits = 6;
+    static const int kSlots = 1 << kSlotBits;
+    const uint64_t mTickNs;
+    // the next tick that has not been processed by advance()
+    uint64_t mCurTick;
+    LocTimerDelegate* mSlots[kLevels][kSlots];
+    // earliest due tick of the timers added to a slot since it was last
+    // emptied. remove() does not raise it; a stale value only costs an
+    // early wake up.
+    uint64_t mSlotMin[kLevels][kSlots];
+    // bit n set if mSlots[level][n] is not empty
+    uint64_t mOccupied[kLevels];
+    size_t mCount;
+
+    // link the timer into the slot for its due tick, relative to mCurTick
+    void place(LocTimerDelegate& timer);
+    void unlink(LocTimerDelegate& timer);
+    // detach the whole list of a slot
+    LocTimerDelegate* takeSlot(int level, int slot);
+    // tick at which level has to be looked at next, i.e. the start of its
+    // next busy slot, which is returned in slot. UINT64_MAX if level is empty.
+    uint64_t nextEventTick(int level, int& slot);
+public:
+    LocTimerWheel(uint32_t slackInMs, uint64_t nowNs);
+    void add(LocTimerDelegate& timer);
+    // returns false if timer is not in the wheel
+    bool remove(LocTimerDelegate& timer);
+    // take out all the timers due at or before nowNs, in the order of their
+    // due ticks, as a list linked through mWheelNext
+    LocTimerDelegate* advance(uint64_t nowNs);
+    // take out all the timers, as a list linked through mWheelNext
+    LocTimerDelegate* takeAll();
+    // slot boundary in ns the kernel timer should fire at, 0 if empty
+    uint64_t nextDeadlineNs();
+    inline size_t size() { return mCount; }
+    inline uint64_t getTickNs() { return mTickNs; }
+};
+
 // Internal class of timer obj. It gets born when client calls LocTimer::start();
 // and gets deleted when client calls LocTimer::stop() or when the it expire()'s.
 // This class implements LocRankable::ranks() so that when an obj is added into
 // the container (of LocHeap), it gets placed in sorted order.
 class LocTimerDelegate : public LocRankable {
     friend class LocTimerContainer;
+    friend class LocTimerWheel;
     friend class LocTimer;
     LocTimer* mClient;
     LocSharedLock* mLock;
     struct timespec mFutureTime;
     LocTimerContainer* mContainer;
+    // links and slot head of this obj in a LocTimerWheel; mWheelSlot is
+    // NULL if not in a wheel
+    LocTimerDelegate* mWheelPrev;
+    LocTimerDelegate* mWheelNext;
+    LocTimerDelegate** mWheelSlot;
+    uint64_t mDueTick;
     // not a complete obj, just ctor for LocRankable comparisons
     inline LocTimerDelegate(struct timespec& delay)
-        : mClient(NULL), mLock(NULL), mFutureTime(delay), mContainer(NULL) {}
+        : mClient(NULL), mLock(NULL), mFutureTime(delay), mContainer(NULL),
+          mWheelPrev(NULL), mWheelNext(NULL), mWheelSlot(NULL), mDueTick(0) {}
     inline ~LocTimerDelegate() { if (mLock) { mLock->drop(); mLock = NULL; } }
 public:
     LocTimerDelegate(LocTimer& client, struct timespec& futureTime, bool wakeOnExpire);
     void destroyLocked();
     // LocRankable virtual method
     virtual int ranks(LocRankable& rankable);
-    void expire();
+    // returns true if the client callback was called. tickNs is the tick
+    // of the wheel the timer was in, or 0 if it was in the heap.
+    bool expire(uint64_t wakeNs, uint64_t tickNs);
     inline struct timespec getFutureTime() { return mFutureTime; }
 };
 
@@ -203,12 +312,17 @@ LocTimerContainer* LocTimerContainer::mSwTimers = NULL;
 LocTimerContainer* LocTimerContainer::mHwTimers = NULL;
 MsgTask* LocTimerContainer::mMsgTask = NULL;
 LocTimerPollTask* LocTimerContainer::mPollTask = NULL;
+uint32_t LocTimerContainer::mSwSlackInMs = 0;
+uint32_t LocTimerContainer::mHwSlackInMs = 0;
 
 // ctor - initialize timer heaps
 // A container for swTimer (timer) is created, when wakeOnExpire is true; or
 // HwTimer (alarm), when wakeOnExpire is false.
 LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
-    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)) {
+    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)),
+    mWheel(NULL), mArmedNs(0) {
+    pthread_mutex_init(&mStatsMutex, NULL);
+    memset(&mStats, 0, sizeof(mStats));
 
     if ((-1 == mDevFd) && (errno == EINVAL)) {
         LOC_LOGW("%s: timerfd_create failure, fallback to CLOCK_MONOTONIC - %s",
@@ -220,6 +334,13 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
         // ensure we have the necessary resources created
         LocTimerContainer::getPollTaskLocked();
         LocTimerContainer::getMsgTaskLocked();
+        // the caller holds mMutex, so the slack can be read here
+        uint32_t slackInMs = wakeOnExpire ? mHwSlackInMs : mSwSlackInMs;
+        if (slackInMs) {
+            struct timespec now;
+            clock_gettime(CLOCK_BOOTTIME, &now);
+            mWheel = new LocTimerWheel(slackInMs, timespecToNs(now));
+        }
     } else {
         LOC_LOGE("%s: timerfd_create failure - %s", __FUNCTION__, strerror(errno));
     }
@@ -230,6 +351,8 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
 inline
 LocTimerContainer::~LocTimerContainer() {
     close(mDevFd);
+    delete mWheel;
+    pthread_mutex_destroy(&mStatsMutex);
 }
 
 LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
@@ -252,6 +375,29 @@ LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
     return container;
 }
 
+void LocTimerContainer::setSlack(uint32_t slackInMs, bool wakeOnExpire) {
+    pthread_mutex_lock(&mMutex);
+    (wakeOnExpire ? mHwSlackInMs : mSwSlackInMs) = slackInMs;
+    LocTimerContainer* container = wakeOnExpire ? mHwTimers : mSwTimers;
+    pthread_mutex_unlock(&mMutex);
+
+    // an existing container switches over in the MsgTask context, so the
+    // running timers move along in order with the other add / remove
+    if (container) {
+        struct MsgTimerSetSlack : public LocMsg {
+            LocTimerContainer* mTimerContainer;
+            uint32_t mSlackInMs;
+            inline MsgTimerSetSlack(LocTimerContainer& container, uint32_t slackInMs) :
+                LocMsg(), mTimerContainer(&container), mSlackInMs(slackInMs) {}
+            inline virtual void proc() const {
+                mTimerContainer->switchBackend(mSlackInMs);
+            }
+        };
+
+        mMsgTask->sendMsg(new MsgTimerSetSlack(*container, slackInMs));
+    }
+}
+
 MsgTask* LocTimerContainer::getMsgTaskLocked() {
     // it is cheap to check pointer first than locking mutext unconditionally
     if (!mMsgTask) {
@@ -278,7 +424,17 @@ int LocTimerContainer::getTimerFd() {
     return mDevFd;
 }
 
+inline
+size_t LocTimerContainer::getDepth() {
+    return mWheel ? mWheel->size() : size();
+}
+
 void LocTimerContainer::updateSoonestTime(LocTimerDelegate* priorTop) {
+    if (mWheel) {
+        updateWheelTime();
+        return;
+    }
+
     LocTimerDelegate* curTop = getSoonestTimer();
 
     // check if top has changed
@@ -301,22 +457,93 @@ void LocTimerContainer::updateSoonestTime(LocTimerDelegate* priorTop) {
         }
         if (toSetTime) {
             timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+            noteRearm();
         }
     }
 }
 
+void LocTimerContainer::updateWheelTime() {
+    uint64_t deadlineNs = mWheel->nextDeadlineNs();
+
+    // the fd stays armed as long as the soonest slot boundary is the same,
+    // no matter how many timers come and go in between
+    if (deadlineNs != mArmedNs) {
+        struct itimerspec delay = {{0,0}, {0,0}};
+        if (!deadlineNs) {
+            mPollTask->removePoll(*this);
+        } else {
+            if (!mArmedNs) {
+                mPollTask->addPoll(*this);
+            }
+            delay.it_value.tv_sec = deadlineNs / 1000000000ULL;
+            delay.it_value.tv_nsec = deadlineNs % 1000000000ULL;
+        }
+        timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+        noteRearm();
+        mArmedNs = deadlineNs;
+    }
+}
+
+void LocTimerContainer::switchBackend(uint32_t slackInMs) {
+    // collect all the running timers, linked through mWheelNext
+    LocTimerDelegate* timers = NULL;
+    if (mWheel) {
+        timers = mWheel->takeAll();
+        delete mWheel;
+        mWheel = NULL;
+    } else {
+        for (LocTimerDelegate* timer = (LocTimerDelegate*)pop();
+             NULL != timer;
+             timer = (LocTimerDelegate*)pop()) {
+            timer->mWheelNext = timers;
+            timers = timer;
+        }
+    }
+
+    if (slackInMs) {
+        struct timespec now;
+        clock_gettime(CLOCK_BOOTTIME, &now);
+        mWheel = new LocTimerWheel(slackInMs, timespecToNs(now));
+    }
+
+    while (timers) {
+        LocTimerDelegate* timer = timers;
+        timers = timer->mWheelNext;
+        timer->mWheelNext = NULL;
+        if (mWheel) {
+            mWheel->add(*timer);
+        } else if (!push((LocRankable&)(*timer))) {
+            LOC_LOGE("%s: no memory to move timer %p", __FUNCTION__, timer);
+        }
+    }
+
+    // the fd state is unknown to the new backend, so always re-arm it
+    mPollTask->removePoll(*this);
+    mArmedNs = 0;
+    updateSoonestTime(NULL);
+}
+
 // all the heap management is done in the MsgTask context.
 inline
 void LocTimerContainer::add(LocTimerDelegate& timer) {
     struct MsgTimerPush : public LocMsg {
         LocTimerContainer* mTimerContainer;
-        LocHeapNode* mTree;
         LocTimerDelegate* mTimer;
         inline MsgTimerPush(LocTimerContainer& container, LocTimerDelegate& timer) :
             LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
         inline virtual void proc() const {
+            if (mTimerContainer->mWheel) {
+                mTimerContainer->mWheel->add(*mTimer);
+                mTimerContainer->noteStart();
+                mTimerContainer->updateWheelTime();
+                return;
+            }
             LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-            mTimerContainer->push((LocRankable&)(*mTimer));
+            if (!mTimerContainer->push((LocRankable&)(*mTimer))) {
+                LOC_LOGE("%s: no memory to add timer %p", __FUNCTION__, mTimer);
+                return;
+            }
+            mTimerContainer->noteStart();
             mTimerContainer->updateSoonestTime(priorTop);
         }
     };
@@ -332,11 +559,23 @@ void LocTimerContainer::remove(LocTimerDelegate& timer) {
         inline MsgTimerRemove(LocTimerContainer& container, LocTimerDelegate& timer) :
             LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
         inline virtual void proc() const {
+            if (mTimerContainer->mWheel) {
+                if (mTimerContainer->mWheel->remove(*mTimer)) {
+                    mTimerContainer->noteStop();
+                    mTimerContainer->updateWheelTime();
+                }
+                delete mTimer;
+                return;
+            }
             LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
 
+            LocRankable* removed = ((LocHeap*)mTimerContainer)->remove((LocRankable&)*mTimer);
+            if (removed) {
+                mTimerContainer->noteStop();
+            }
             // update soonest timer only if mTimer is actually removed from
             // mTimerContainer AND mTimer is not priorTop.
-            if (priorTop == ((LocHeap*)mTimerContainer)->remove((LocRankable&)*mTimer)) {
+            if (priorTop == removed) {
                 // if passing in NULL, we tell updateSoonestTime to update
                 // kernel with the current top timer interval.
                 mTimerContainer->updateSoonestTime(NULL);
@@ -352,15 +591,38 @@ void LocTimerContainer::remove(LocTimerDelegate& timer) {
 // all the heap management is done in the MsgTask context.
 // Upon expire, we check and continuously pop the heap until
 // the top node's timeout is in the future.
-void LocTimerContainer::expire() {
+void LocTimerContainer::expire(uint64_t wakeNs) {
     struct MsgTimerExpire : public LocMsg {
         LocTimerContainer* mTimerContainer;
-        inline MsgTimerExpire(LocTimerContainer& container) :
-            LocMsg(), mTimerContainer(&container) {}
+        uint64_t mWakeNs;
+        inline MsgTimerExpire(LocTimerContainer& container, uint64_t wakeNs) :
+            LocMsg(), mTimerContainer(&container), mWakeNs(wakeNs) {}
         inline virtual void proc() const {
             struct timespec now;
             // get time spec of now
             clock_gettime(CLOCK_BOOTTIME, &now);
+            uint64_t startNs = timespecToNs(now);
+            uint32_t count = 0;
+            if (mTimerContainer->mWheel) {
+                // the fd was disarmed in expire()
+                mTimerContainer->mArmedNs = 0;
+                // all the timers due by now, expired in this one message
+                LocTimerDelegate* timer =
+                    mTimerContainer->mWheel->advance(timespecToNs(now));
+                while (NULL != timer) {
+                    LocTimerDelegate* next = timer->mWheelNext;
+                    timer->mWheelNext = NULL;
+                    // the timer delegate obj is deleted in a later msg
+                    if (timer->expire(mWakeNs,
+                                      mTimerContainer->mWheel->getTickNs())) {
+                        count++;
+                    }
+                    timer = next;
+                }
+                mTimerContainer->noteBatch(mWakeNs, startNs, count);
+                mTimerContainer->updateWheelTime();
+                return;
+            }
             LocTimerDelegate timerOfNow(now);
             // pop everything in the heap that outRanks now, i.e. has time older than now
             // and then call expire() on that timer.
@@ -368,27 +630,376 @@ void LocTimerContainer::expire() {
                  NULL != timer;
                  timer = mTimerContainer->popIfOutRanks(timerOfNow)) {
                 // the timer delegate obj will be deleted before the return of this call
-                timer->expire();
+                if (timer->expire(mWakeNs, 0)) {
+                    count++;
+                }
             }
+            mTimerContainer->noteBatch(mWakeNs, startNs, count);
             mTimerContainer->updateSoonestTime(NULL);
         }
     };
 
     struct itimerspec delay = {{0,0}, {0,0}};
     timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+    noteWakeup();
     mPollTask->removePoll(*this);
-    mMsgTask->sendMsg(new MsgTimerExpire(*this));
+    mMsgTask->sendMsg(new MsgTimerExpire(*this, wakeNs));
 }
 
 LocTimerDelegate* LocTimerContainer::popIfOutRanks(LocTimerDelegate& timer) {
     LocTimerDelegate* poppedNode = NULL;
-    if (mTree && !timer.outRanks(*peek())) {
+    if (mSize && !timer.outRanks(*peek())) {
         poppedNode = (LocTimerDelegate*)(pop());
     }
 
     return poppedNode;
 }
 
+void LocTimerContainer::noteRearm() {
+    pthread_mutex_lock(&mStatsMutex);
+    mStats.rearms++;
+    pthread_mutex_unlock(&mStatsMutex);
+}
+
+// the disarm in expire() counts as a rearm too, being a syscall all the same
+void LocTimerContainer::noteWakeup() {
+    pthread_mutex_lock(&mStatsMutex);
+    mStats.wakeups++;
+    mStats.rearms++;
+    pthread_mutex_unlock(&mStatsMutex);
+}
+
+void LocTimerContainer::noteStart() {
+    uint32_t depth = getDepth();
+    pthread_mutex_lock(&mStatsMutex);
+    mStats.started++;
+    mStats.depth = depth;
+    if (depth > mStats.maxDepth) {
+        mStats.maxDepth = depth;
+    }
+    pthread_mutex_unlock(&mStatsMutex);
+}
+
+void LocTimerContainer::noteStop() {
+    uint32_t depth = getDepth();
+    pthread_mutex_lock(&mStatsMutex);
+    mStats.stopped++;
+    mStats.depth = depth;
+    pthread_mutex_unlock(&mStatsMutex);
+}
+
+void LocTimerContainer::noteBatch(uint64_t wakeNs, uint64_t startNs, uint32_t count) {
+    uint32_t depth = getDepth();
+    uint64_t queueNs = (startNs > wakeNs) ? startNs - wakeNs : 0;
+    pthread_mutex_lock(&mStatsMutex);
+    mStats.batches++;
+    if (count > mStats.maxBatch) {
+        mStats.maxBatch = count;
+    }
+    mStats.queueTotalNs += queueNs;
+    if (queueNs > mStats.queueMaxNs) {
+        mStats.queueMaxNs = queueNs;
+    }
+    mStats.depth = depth;
+    pthread_mutex_unlock(&mStatsMutex);
+}
+
+void LocTimerContainer::noteExpiry(uint64_t dueNs, uint64_t wakeNs,
+                                   uint64_t startNs, uint64_t endNs) {
+    uint64_t lateNs = (startNs > dueNs) ? startNs - dueNs : 0;
+    // a timer that came due after the wake up, while the batch waited in
+    // the queue, was not late for the poll
+    uint64_t pollLateNs = (wakeNs > dueNs) ? wakeNs - dueNs : 0;
+    uint64_t callbackNs = endNs - startNs;
+    int bucket = 0;
+    for (uint64_t ms = lateNs / 1000000;
+         ms && bucket < LocTimerStats::LATE_HISTOGRAM_BUCKETS - 1;
+         ms >>= 1) {
+        bucket++;
+    }
+
+    pthread_mutex_lock(&mStatsMutex);
+    mStats.expired++;
+    mStats.lateTotalNs += lateNs;
+    if (lateNs > mStats.lateMaxNs) {
+        mStats.lateMaxNs = lateNs;
+    }
+    mStats.pollLateTotalNs += pollLateNs;
+    if (pollLateNs > mStats.pollLateMaxNs) {
+        mStats.pollLateMaxNs = pollLateNs;
+    }
+    mStats.callbackTotalNs += callbackNs;
+    if (callbackNs > mStats.callbackMaxNs) {
+        mStats.callbackMaxNs = callbackNs;
+    }
+    mStats.lateHistogram[bucket]++;
+    pthread_mutex_unlock(&mStatsMutex);
+}
+
+void LocTimerContainer::copyStats(LocTimerStats& stats, bool reset) {
+    pthread_mutex_lock(&mStatsMutex);
+    stats = mStats;
+    if (reset) {
+        // the running timers are still running
+        uint32_t depth = mStats.depth;
+        memset(&mStats, 0, sizeof(mStats));
+        mStats.depth = mStats.maxDepth = depth;
+    }
+    pthread_mutex_unlock(&mStatsMutex);
+}
+
+bool LocTimerContainer::getStats(bool wakeOnExpire, LocTimerStats& stats, bool reset) {
+    pthread_mutex_lock(&mMutex);
+    LocTimerContainer* container = wakeOnExpire ? mHwTimers : mSwTimers;
+    pthread_mutex_unlock(&mMutex);
+
+    if (!container) {
+        memset(&stats, 0, sizeof(stats));
+        return false;
+    }
+    container->copyStats(stats, reset);
+    return true;
+}
+
+void LocTimerContainer::dumpStats(int fd) {
+    for (int i = 0; i < 2; i++) {
+        bool wakeOnExpire = (1 == i);
+        const char* name = wakeOnExpire ? "alarms" : "timers";
+        LocTimerStats stats;
+        if (!getStats(wakeOnExpire, stats, false)) {
+            dprintf(fd, "LocTimer %s: none\n", name);
+            continue;
+        }
+        uint32_t expired = stats.expired ? stats.expired : 1;
+        uint32_t batches = stats.batches ? stats.batches : 1;
+        dprintf(fd, "LocTimer %s: running %u (max %u), started %u, stopped %u, "
+                "expired %u, wakeups %u, batches %u (max %u), rearms %u\n",
+                name, stats.depth, stats.maxDepth, stats.started, stats.stopped,
+                stats.expired, stats.wakeups, stats.batches, stats.maxBatch,
+                stats.rearms);
+        dprintf(fd, "  late avg %.3fms max %.3fms, poll avg %.3fms max %.3fms, "
+                "queue avg %.3fms max %.3fms, callback avg %.3fms max %.3fms\n",
+                stats.lateTotalNs / 1e6 / expired, stats.lateMaxNs / 1e6,
+                stats.pollLateTotalNs / 1e6 / expired, stats.pollLateMaxNs / 1e6,
+                stats.queueTotalNs / 1e6 / batches, stats.queueMaxNs / 1e6,
+                stats.callbackTotalNs / 1e6 / expired, stats.callbackMaxNs / 1e6);
+        dprintf(fd, "  late histogram (ms):");
+        for (int b = 0; b < LocTimerStats::LATE_HISTOGRAM_BUCKETS; b++) {
+            if (b < LocTimerStats::LATE_HISTOGRAM_BUCKETS - 1) {
+                dprintf(fd, " <%u:%u", 1u << b, stats.lateHistogram[b]);
+            } else {
+                dprintf(fd, " >=%u:%u", 1u << (b - 1), stats.lateHistogram[b]);
+            }
+        }
+        dprintf(fd, "\n");
+    }
+
+    pthread_mutex_lock(&mMutex);
+    MsgTask* msgTask = mMsgTask;
+    pthread_mutex_unlock(&mMutex);
+    if (msgTask) {
+        size_t depth, highWaterMark;
+        msgTask->getQueueDepth(depth, highWaterMark);
+        dprintf(fd, "LocTimer msg queue: depth %zu (max %zu)\n", depth, highWaterMark);
+    }
+}
+
+
+/***************************LocTimerWheel methods***************************/
+
+LocTimerWheel::LocTimerWheel(uint32_t slackInMs, uint64_t nowNs) :
+    mTickNs((uint64_t)slackInMs * 1000000ULL), mCurTick(nowNs / mTickNs),
+    mCount(0) {
+    memset(mSlots, 0, sizeof(mSlots));
+    memset(mSlotMin, 0xff, sizeof(mSlotMin));
+    memset(mOccupied, 0, sizeof(mOccupied));
+}
+
+void LocTimerWheel::place(LocTimerDelegate& timer) {
+    // timers already due go into the slot that is processed next
+    uint64_t due = (timer.mDueTick < mCurTick) ? mCurTick : timer.mDueTick;
+    uint64_t delta = due - mCurTick;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) {
+        level++;
+    }
+    // beyond the reach of the top level, park in its furthest slot
+    uint64_t slotTick = due;
+    if (delta >= (1ULL << (kSlotBits * kLevels))) {
+        slotTick = mCurTick + (1ULL << (kSlotBits * kLevels)) - 1;
+    }
+    int slot = (slotTick >> (kSlotBits * level)) & (kSlots - 1);
+
+    LocTimerDelegate*& head = mSlots[level][slot];
+    timer.mWheelPrev = NULL;
+    timer.mWheelNext = head;
+    timer.mWheelSlot = &head;
+    if (head) {
+        head->mWheelPrev = &timer;
+    }
+    head = &timer;
+    mOccupied[level] |= (1ULL << slot);
+    if (due < mSlotMin[level][slot]) {
+        mSlotMin[level][slot] = due;
+    }
+}
+
+void LocTimerWheel::unlink(LocTimerDelegate& timer) {
+    LocTimerDelegate** head = timer.mWheelSlot;
+    if (timer.mWheelPrev) {
+        timer.mWheelPrev->mWheelNext = timer.mWheelNext;
+    } else {
+        *head = timer.mWheelNext;
+    }
+    if (timer.mWheelNext) {
+        timer.mWheelNext->mWheelPrev = timer.mWheelPrev;
+    }
+    if (!*head) {
+        int index = head - &mSlots[0][0];
+        mOccupied[index / kSlots] &= ~(1ULL << (index % kSlots));
+        mSlotMin[index / kSlots][index % kSlots] = UINT64_MAX;
+    }
+    timer.mWheelPrev = NULL;
+    timer.mWheelNext = NULL;
+    timer.mWheelSlot = NULL;
+}
+
+LocTimerDelegate* LocTimerWheel::takeSlot(int level, int slot) {
+    LocTimerDelegate* list = mSlots[level][slot];
+    mSlots[level][slot] = NULL;
+    mOccupied[level] &= ~(1ULL << slot);
+    mSlotMin[level][slot] = UINT64_MAX;
+    for (LocTimerDelegate* timer = list; timer; timer = timer->mWheelNext) {
+        timer->mWheelPrev = NULL;
+        timer->mWheelSlot = NULL;
+    }
+    return list;
+}
+
+uint64_t LocTimerWheel::nextEventTick(int level, int& slot) {
+    if (!mOccupied[level]) {
+        return UINT64_MAX;
+    }
+    int shift = kSlotBits * level;
+    // the first slot start at or after mCurTick. A slot that started before
+    // mCurTick has been cascaded already, so if it is busy again it is for
+    // its next turn, a full round later.
+    uint64_t base = (mCurTick + (1ULL << shift) - 1) >> shift;
+    int pos = base & (kSlots - 1);
+    uint64_t rotated = mOccupied[level] >> pos;
+    if (pos) {
+        rotated |= mOccupied[level] << (kSlots - pos);
+    }
+    int distance = __builtin_ctzll(rotated);
+    slot = (pos + distance) & (kSlots - 1);
+    return (base + distance) << shift;
+}
+
+void LocTimerWheel::add(LocTimerDelegate& timer) {
+    // round up, so that no timer fires before its time
+    timer.mDueTick = (timespecToNs(timer.mFutureTime) + mTickNs - 1) / mTickNs;
+    place(timer);
+    mCount++;
+}
+
+bool LocTimerWheel::remove(LocTimerDelegate& timer) {
+    LocTimerDelegate** head = timer.mWheelSlot;
+    if (!head || head < &mSlots[0][0] || head >= &mSlots[0][0] + kLevels * kSlots) {
+        return false;
+    }
+    unlink(timer);
+    mCount--;
+    return true;
+}
+
+LocTimerDelegate* LocTimerWheel::advance(uint64_t nowNs) {
+    uint64_t nowTick = nowNs / mTickNs;
+    LocTimerDelegate* expired = NULL;
+    LocTimerDelegate** tail = &expired;
+
+    // jump from one event to the next, instead of stepping every tick
+    for (;;) {
+        uint64_t tick = UINT64_MAX;
+        for (int level = 0; level < kLevels; level++) {
+            int slot;
+            uint64_t levelTick = nextEventTick(level, slot);
+            if (levelTick < tick) {
+                tick = levelTick;
+            }
+        }
+        if (tick > nowTick) {
+            break;
+        }
+
+        mCurTick = tick;
+        // cascade every level whose slot starts at this tick
+        for (int level = kLevels - 1; level > 0; level--) {
+            int shift = kSlotBits * level;
+            if (tick & ((1ULL << shift) - 1)) {
+                continue;
+            }
+            LocTimerDelegate* timer = takeSlot(level, (tick >> shift) & (kSlots - 1));
+            while (timer) {
+                LocTimerDelegate* next = timer->mWheelNext;
+                place(*timer);
+                timer = next;
+            }
+        }
+
+        // and whatever lands on level 0 for this tick is due
+        LocTimerDelegate* timer = takeSlot(0, tick & (kSlots - 1));
+        while (timer) {
+            *tail = timer;
+            tail = &timer->mWheelNext;
+            timer = timer->mWheelNext;
+            mCount--;
+        }
+        mCurTick = tick + 1;
+    }
+
+    if (mCurTick <= nowTick) {
+        mCurTick = nowTick + 1;
+    }
+    return expired;
+}
+
+LocTimerDelegate* LocTimerWheel::takeAll() {
+    LocTimerDelegate* all = NULL;
+    LocTimerDelegate** tail = &all;
+    for (int level = 0; level < kLevels; level++) {
+        for (int slot = 0; slot < kSlots; slot++) {
+            if (mSlots[level][slot]) {
+                *tail = takeSlot(level, slot);
+                while (*tail) {
+                    tail = &(*tail)->mWheelNext;
+                }
+            }
+        }
+    }
+    mCount = 0;
+    return all;
+}
+
+uint64_t LocTimerWheel::nextDeadlineNs() {
+    uint64_t deadline = UINT64_MAX;
+    for (int level = 0; level < kLevels; level++) {
+        int slot;
+        uint64_t tick = nextEventTick(level, slot);
+        if (UINT64_MAX != tick) {
+            // the first busy slot of each level holds that level's soonest
+            // timer. Waking for a cascade alone would be wasted, so wake
+            // for the soonest timer in it instead. advance() cascades late
+            // just as well.
+            if (mSlotMin[level][slot] > tick) {
+                tick = mSlotMin[level][slot];
+            }
+            if (tick < deadline) {
+                deadline = tick;
+            }
+        }
+    }
+    return (UINT64_MAX == deadline) ? 0 : deadline * mTickNs;
+}
 
 /***************************LocTimerPollTask methods***************************/
 
@@ -453,12 +1064,14 @@ bool LocTimerPollTask::run() {
     bool rerun = (fds > 0) || (errno == EINTR);
 
     if (fds > 0) {
+        // taken once for all, to tell poll lateness from queueing later
+        uint64_t wakeNs = getBootTimeNs();
         // we may have 2 events
         for (int i = 0; i < fds; i++) {
             // each fd has a context pointer associated with the right timer container
             LocTimerContainer* container = (LocTimerContainer*)(ev[i].data.ptr);
             if (container) {
-                container->expire();
+                container->expire(wakeNs);
             } else {
                 epoll_ctl(mFd, EPOLL_CTL_DEL, ev[i].data.fd, NULL);
             }
@@ -476,7 +1089,8 @@ LocTimerDelegate::LocTimerDelegate(LocTimer& client, struct timespec& futureTime
     : mClient(&client),
       mLock(mClient->mLock->share()),
       mFutureTime(futureTime),
-      mContainer(LocTimerContainer::get(wakeOnExpire)) {
+      mContainer(LocTimerContainer::get(wakeOnExpire)),
+      mWheelPrev(NULL), mWheelNext(NULL), mWheelSlot(NULL), mDueTick(0) {
     // adding the timer into the container
     mContainer->add(*this);
 }
@@ -517,18 +1131,29 @@ int LocTimerDelegate::ranks(LocRankable& rankable) {
 }
 
 inline
-void LocTimerDelegate::expire() {
+bool LocTimerDelegate::expire(uint64_t wakeNs, uint64_t tickNs) {
     // keeping a copy of client pointer to be safe
     // when timeOutCallback() is called at the end of this
     // method, *this* obj may be already deleted.
     LocTimer* client = mClient;
+    // stop() clears mContainer, keep what is needed for the statistics
+    LocTimerContainer* container = mContainer;
+    // a wheel fires on the tick boundary by design, so the slack up to it
+    // is not lateness
+    uint64_t dueNs = tickNs ? mDueTick * tickNs : timespecToNs(mFutureTime);
     // force a stop, which will lead to delete of this obj
     if (client && client->stop()) {
         // calling client callback with a pointer save on the stack
         // only if stop() returns true, i.e. it hasn't been stopped
         // already.
+        uint64_t startNs = getBootTimeNs();
         client->timeOutCallback();
+        if (container) {
+            container->noteExpiry(dueNs, wakeNs, startNs, getBootTimeNs());
+        }
+        return true;
     }
+    return false;
 }
 
 
@@ -564,6 +1189,18 @@ bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire) {
     return success;
 }
 
+void LocTimer::setSlack(uint32_t slackInMs, bool wakeOnExpire) {
+    LocTimerContainer::setSlack(slackInMs, wakeOnExpire);
+}
+
+bool LocTimer::getStats(bool wakeOnExpire, LocTimerStats& stats, bool reset) {
+    return LocTimerContainer::getStats(wakeOnExpire, stats, reset);
+}
+
+void LocTimer::dumpStats(int fd) {
+    LocTimerContainer::dumpStats(fd);
+}
+
 bool LocTimer::stop() {
     bool success = false;
     mLock->lock();
@@ -637,6 +1274,16 @@ void loc_timer_stop(void*&  handle)
     }
 }
 
+void loc_timer_set_slack(uint32_t slack_msec, bool wake_on_expire)
+{
+    LocTimer::setSlack(slack_msec, wake_on_expire);
+}
+
+void loc_timer_dump_stats(int fd)
+{
+    LocTimer::dumpStats(fd);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // This section above wraps for the C style APIs
 //////////////////////////////////////////////////////////////////////////
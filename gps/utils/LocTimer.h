@@ -31,12 +31,45 @@
 #define __LOC_TIMER_CPP_H__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <log_util.h>
 
 // opaque class to provide service implementation.
 class LocTimerDelegate;
 class LocSharedLock;
 
+// Statistics of the timers, or of the alarms, of this process. They are
+// always kept. Times are in ns. Lateness is measured from the timeout of a
+// timer, or with a slack from the tick boundary it was rounded up to, to
+// the start of its callback. Part of it is poll lateness, until
+// the poll thread woke up; the rest is the time the expiry waited in the
+// MsgTask queue, and the callbacks run before it in the same batch.
+struct LocTimerStats {
+    enum { LATE_HISTOGRAM_BUCKETS = 12 };
+    uint32_t started;       // timers added
+    uint32_t stopped;       // timers stopped before they expired
+    uint32_t expired;       // timer callbacks called
+    uint32_t wakeups;       // poll thread wake ups
+    uint32_t batches;       // expiry msgs processed
+    uint32_t maxBatch;      // most callbacks called by one expiry msg
+    uint32_t rearms;        // timerfd_settime() calls
+    uint32_t depth;         // timers running now
+    uint32_t maxDepth;
+    uint64_t lateTotalNs;
+    uint64_t lateMaxNs;
+    uint64_t pollLateTotalNs;
+    uint64_t pollLateMaxNs;
+    // per batch, from the poll wake up to the expiry msg running
+    uint64_t queueTotalNs;
+    uint64_t queueMaxNs;
+    // time taken by timeOutCallback(), on the MsgTask shared by all timers
+    uint64_t callbackTotalNs;
+    uint64_t callbackMaxNs;
+    // bucket 0 counts lateness under 1ms, bucket n under 2^n ms, and the
+    // last bucket the rest
+    uint32_t lateHistogram[LATE_HISTOGRAM_BUCKETS];
+};
+
 // LocTimer client must extend this class and implementthe callback.
 // start() / stop() methods are to arm / disarm timer.
 class LocTimer
@@ -65,6 +98,23 @@ public:
     //               false on failure, e.g. timer is not running.
     bool stop();
 
+    // slackInMs:    coalescing window in ms for the timers (wakeOnExpire
+    //               false) or alarms (wakeOnExpire true) of this process.
+    //               When non 0, they are kept in a timer wheel with ticks
+    //               of this length, and fire on the first tick boundary at
+    //               or after their timeout, together with all the others
+    //               due in the same tick. 0 (default) fires each one at
+    //               its exact timeout. Running timers are carried over.
+    static void setSlack(uint32_t slackInMs, bool wakeOnExpire);
+
+    // copies the statistics of the timers (wakeOnExpire false) or alarms
+    // (wakeOnExpire true) into stats, then clears them if reset is true.
+    // return:       false if no such timer was ever started.
+    static bool getStats(bool wakeOnExpire, LocTimerStats& stats, bool reset = false);
+
+    // writes the statistics of both timers and alarms as text to fd
+    static void dumpStats(int fd);
+
     //  LocTimer client Should implement this method.
     //  This method is used for timeout calling back to client. This method
     //  should be short enough (eg: send a message to your own thread).
@@ -32,17 +32,20 @@
 #include <cutils/sched_policy.h>
 #include <unistd.h>
 #include <MsgTask.h>
-#include <msg_q.h>
+#include <msg_ring.h>
 #include <log_util.h>
 #include <loc_log.h>
 
+// Messages beyond this many spill into a slower overflow list
+#define MSG_TASK_RING_SIZE 256
+
 static void LocMsgDestroy(void* msg) {
     delete (LocMsg*)msg;
 }
 
 MsgTask::MsgTask(LocThread::tCreate tCreator,
                  const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
+    mQ(msg_ring_init(MSG_TASK_RING_SIZE, LocMsgDestroy)), mThread(new LocThread()) {
     if (!mThread->start(tCreator, threadName, this, joinable)) {
         delete mThread;
         mThread = NULL;
@@ -50,7 +53,7 @@ MsgTask::MsgTask(LocThread::tCreate tCreator,
 }
 
 MsgTask::MsgTask(const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
+    mQ(msg_ring_init(MSG_TASK_RING_SIZE, LocMsgDestroy)), mThread(new LocThread()) {
     if (!mThread->start(threadName, this, joinable)) {
         delete mThread;
         mThread = NULL;
@@ -58,12 +61,11 @@ MsgTask::MsgTask(const char* threadName, bool joinable) :
 }
 
 MsgTask::~MsgTask() {
-    msg_q_flush((void*)mQ);
-    msg_q_destroy((void**)&mQ);
+    msg_ring_destroy((void**)&mQ);
 }
 
 void MsgTask::destroy() {
-    msg_q_unblock((void*)mQ);
+    msg_ring_unblock((void*)mQ);
     if (mThread) {
         LocThread* thread = mThread;
         mThread = NULL;
@@ -74,7 +76,15 @@ void MsgTask::destroy() {
 }
 
 void MsgTask::sendMsg(const LocMsg* msg) const {
-    msg_q_snd((void*)mQ, (void*)msg, LocMsgDestroy);
+    // the queue owns msg from here on; it is deleted after proc() or on flush
+    if (eMSG_Q_SUCCESS != msg_ring_snd((void*)mQ, (void*)msg)) {
+        delete msg;
+    }
+}
+
+void MsgTask::getQueueDepth(size_t& depth, size_t& highWaterMark) const {
+    depth = highWaterMark = 0;
+    msg_ring_depth((void*)mQ, &depth, &highWaterMark);
 }
 
 void MsgTask::prerun() {
@@ -85,7 +95,7 @@ void MsgTask::prerun() {
 bool MsgTask::run() {
     LOC_LOGV("MsgTask::loop() listening ...\n");
     LocMsg* msg;
-    msq_q_err_type result = msg_q_rcv((void*)mQ, (void **)&msg);
+    msq_q_err_type result = msg_ring_rcv((void*)mQ, (void **)&msg);
     if (eMSG_Q_SUCCESS != result) {
         LOC_LOGE("%s:%d] fail receiving msg: %s\n", __func__, __LINE__,
                  loc_get_msg_q_status(result));
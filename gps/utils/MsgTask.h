@@ -29,6 +29,7 @@
 #ifndef __MSG_TASK__
 #define __MSG_TASK__
 
+#include <stddef.h>
 #include <LocThread.h>
 
 struct LocMsg {
@@ -50,6 +51,8 @@ public:
     // this obj will be deleted once thread is deleted
     void destroy();
     void sendMsg(const LocMsg* msg) const;
+    // number of messages waiting, and the most there have been at once
+    void getQueueDepth(size_t& depth, size_t& highWaterMark) const;
     // Overrides of LocRunnable methods
     // This method will be repeated called until it returns false; or
     // until thread is stopped.
@@ -66,6 +66,22 @@ void* loc_timer_start(uint64_t delay_msec,
 */
 void loc_timer_stop(void*& handle);
 
+/*
+    slack_msec:         coalescing window for the timers started with the
+                        same wake_on_expire. Timers due within the same
+                        window expire together at the end of it. 0 fires
+                        each timer at its exact timeout, which is the
+                        default.
+    wake_on_expire:     selects timers (false) or alarms (true).
+*/
+void loc_timer_set_slack(uint32_t slack_msec, bool wake_on_expire);
+
+/*
+    fd:                 where to write the statistics of the timers and
+                        alarms, e.g. lateness and callback time, as text.
+*/
+void loc_timer_dump_stats(int fd);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
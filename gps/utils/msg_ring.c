@@ -0,0 +1,492 @@
+/* Copyright (c) 2026, The LineageOS Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "msg_ring.h"
+
+#define LOG_TAG "LocSvc_utils_ring"
+#include "log_util.h"
+#include "platform_lib_includes.h"
+#include "linked_list.h"
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct msg_ring_cell {
+   atomic_uint seq;                 /* == position: free to write; == position + 1: readable */
+   void* msg;
+} msg_ring_cell;
+
+/* Senders, the receiver and the sleep word each get their own cache line. */
+typedef struct msg_ring {
+   atomic_uint tail __attribute__((aligned(CACHE_LINE_SIZE)));  /* Next position to claim */
+
+   unsigned int head __attribute__((aligned(CACHE_LINE_SIZE)));  /* Next position to read */
+
+   atomic_int sleeping __attribute__((aligned(CACHE_LINE_SIZE)));  /* Futex; 1 while receiver waits */
+   atomic_int unblocked;
+   atomic_size_t depth;
+   atomic_size_t high_water_mark;
+
+   atomic_int overflowing;          /* Set while overflow holds messages */
+   pthread_mutex_t overflow_mutex;
+   void* overflow;                  /* Linked list of messages that did not fit */
+
+   void (*dealloc)(void*);
+   unsigned int mask;
+   msg_ring_cell* cells;
+} msg_ring;
+
+static void futex_wait(atomic_int* addr, int val)
+{
+   syscall(__NR_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_int* addr, int count)
+{
+   syscall(__NR_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+/*===========================================================================
+FUNCTION    ring_push
+
+DESCRIPTION
+   Claims the next ring slot and publishes msg_obj in it.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0 on success; -1 if the ring is full
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int ring_push(msg_ring* p_ring, void* msg_obj)
+{
+   unsigned int pos = atomic_load_explicit(&p_ring->tail, memory_order_relaxed);
+   msg_ring_cell* cell;
+
+   for (;;)
+   {
+      cell = &p_ring->cells[pos & p_ring->mask];
+      int dif = (int)(atomic_load_explicit(&cell->seq, memory_order_acquire) - pos);
+
+      if( dif == 0 )
+      {
+         if( atomic_compare_exchange_weak_explicit(&p_ring->tail, &pos, pos + 1,
+                                                   memory_order_relaxed, memory_order_relaxed) )
+            break;
+      }
+      else if( dif < 0 )
+      {
+         return -1;
+      }
+      else
+      {
+         pos = atomic_load_explicit(&p_ring->tail, memory_order_relaxed);
+      }
+   }
+
+   cell->msg = msg_obj;
+   atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+   return 0;
+}
+
+/*===========================================================================
+FUNCTION    ring_pop
+
+DESCRIPTION
+   Takes the oldest published message out of the ring. A slot claimed but
+   not yet published reads as empty; its sender wakes the receiver later.
+
+DEPENDENCIES
+   Receiver only.
+
+RETURN VALUE
+   1 if a message was taken; 0 if the ring is empty
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int ring_pop(msg_ring* p_ring, void** msg_obj)
+{
+   unsigned int pos = p_ring->head;
+   msg_ring_cell* cell = &p_ring->cells[pos & p_ring->mask];
+
+   if( atomic_load_explicit(&cell->seq, memory_order_acquire) != pos + 1 )
+      return 0;
+
+   *msg_obj = cell->msg;
+   atomic_store_explicit(&cell->seq, pos + p_ring->mask + 1, memory_order_release);
+   p_ring->head = pos + 1;
+   return 1;
+}
+
+/*===========================================================================
+FUNCTION    overflow_push
+
+DESCRIPTION
+   Queues a message that did not fit in the ring. While the overflow list
+   holds messages every sender appends to it, so that messages from one
+   sender are never reordered around it.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type overflow_push(msg_ring* p_ring, void* msg_obj)
+{
+   msq_q_err_type rv = eMSG_Q_SUCCESS;
+
+   pthread_mutex_lock(&p_ring->overflow_mutex);
+
+   /* The receiver may have emptied the overflow in the meantime. */
+   if( atomic_load_explicit(&p_ring->overflowing, memory_order_relaxed) ||
+       ring_push(p_ring, msg_obj) != 0 )
+   {
+      atomic_store_explicit(&p_ring->overflowing, 1, memory_order_relaxed);
+      if( linked_list_add(p_ring->overflow, msg_obj, p_ring->dealloc) != eLINKED_LIST_SUCCESS )
+         rv = eMSG_Q_FAILURE_GENERAL;
+   }
+
+   pthread_mutex_unlock(&p_ring->overflow_mutex);
+
+   return rv;
+}
+
+/*===========================================================================
+FUNCTION    ring_take
+
+DESCRIPTION
+   Takes the oldest message, from the ring first and then from the overflow.
+
+DEPENDENCIES
+   Receiver only.
+
+RETURN VALUE
+   1 if a message was taken; 0 if the queue is empty
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int ring_take(msg_ring* p_ring, void** msg_obj)
+{
+   int taken = 0;
+
+   if( ring_pop(p_ring, msg_obj) )
+      return 1;
+
+   if( !atomic_load_explicit(&p_ring->overflowing, memory_order_acquire) )
+      return 0;
+
+   pthread_mutex_lock(&p_ring->overflow_mutex);
+   if( !linked_list_empty(p_ring->overflow) &&
+       linked_list_remove(p_ring->overflow, msg_obj) == eLINKED_LIST_SUCCESS )
+      taken = 1;
+   if( linked_list_empty(p_ring->overflow) )
+      atomic_store_explicit(&p_ring->overflowing, 0, memory_order_relaxed);
+   pthread_mutex_unlock(&p_ring->overflow_mutex);
+
+   return taken;
+}
+
+/* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
+
+/*===========================================================================
+
+  FUNCTION:   msg_ring_init
+
+  ===========================================================================*/
+void* msg_ring_init(size_t size, void (*dealloc)(void*))
+{
+   msg_ring* p_ring = NULL;
+   size_t slots = 2;
+
+   while( slots < size )
+      slots <<= 1;
+
+   if( posix_memalign((void**)&p_ring, CACHE_LINE_SIZE, sizeof(msg_ring)) != 0 )
+   {
+      LOC_LOGE("%s: Unable to allocate space for message ring!\n", __FUNCTION__);
+      return NULL;
+   }
+   memset(p_ring, 0, sizeof(msg_ring));
+
+   if( posix_memalign((void**)&p_ring->cells, CACHE_LINE_SIZE, slots * sizeof(msg_ring_cell)) != 0 )
+   {
+      LOC_LOGE("%s: Unable to allocate ring slots!\n", __FUNCTION__);
+      free(p_ring);
+      return NULL;
+   }
+
+   if( linked_list_init(&p_ring->overflow) != eLINKED_LIST_SUCCESS )
+   {
+      LOC_LOGE("%s: Unable to initialize overflow list!\n", __FUNCTION__);
+      free(p_ring->cells);
+      free(p_ring);
+      return NULL;
+   }
+
+   pthread_mutex_init(&p_ring->overflow_mutex, NULL);
+   for( size_t i = 0; i < slots; i++ )
+      atomic_init(&p_ring->cells[i].seq, (unsigned int)i);
+   p_ring->mask = slots - 1;
+   p_ring->dealloc = dealloc;
+
+   return p_ring;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_ring_destroy
+
+  ===========================================================================*/
+msq_q_err_type msg_ring_destroy(void** msg_ring_data)
+{
+   if( msg_ring_data == NULL || *msg_ring_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_ring_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   msg_ring* p_ring = (msg_ring*)*msg_ring_data;
+
+   msg_ring_flush(p_ring);
+   linked_list_destroy(&p_ring->overflow);
+   pthread_mutex_destroy(&p_ring->overflow_mutex);
+   free(p_ring->cells);
+   free(p_ring);
+   *msg_ring_data = NULL;
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_ring_snd
+
+  ===========================================================================*/
+msq_q_err_type msg_ring_snd(void* msg_ring_data, void* msg_obj)
+{
+   msq_q_err_type rv = eMSG_Q_SUCCESS;
+   size_t depth, high;
+
+   if( msg_ring_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_ring_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+   if( msg_obj == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_ring* p_ring = (msg_ring*)msg_ring_data;
+
+   if( atomic_load_explicit(&p_ring->unblocked, memory_order_relaxed) )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   depth = atomic_fetch_add_explicit(&p_ring->depth, 1, memory_order_relaxed) + 1;
+   high = atomic_load_explicit(&p_ring->high_water_mark, memory_order_relaxed);
+   while( depth > high &&
+          !atomic_compare_exchange_weak_explicit(&p_ring->high_water_mark, &high, depth,
+                                                 memory_order_relaxed, memory_order_relaxed) )
+      ;
+
+   if( atomic_load_explicit(&p_ring->overflowing, memory_order_acquire) ||
+       ring_push(p_ring, msg_obj) != 0 )
+      rv = overflow_push(p_ring, msg_obj);
+   if( rv != eMSG_Q_SUCCESS )
+   {
+      atomic_fetch_sub_explicit(&p_ring->depth, 1, memory_order_relaxed);
+      return rv;
+   }
+
+   /* Pairs with the fence in msg_ring_rcv: either it sees the message or we see it sleeping. */
+   atomic_thread_fence(memory_order_seq_cst);
+   if( atomic_load_explicit(&p_ring->sleeping, memory_order_relaxed) &&
+       atomic_exchange(&p_ring->sleeping, 0) )
+      futex_wake(&p_ring->sleeping, 1);
+
+   return rv;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_ring_rcv
+
+  ===========================================================================*/
+msq_q_err_type msg_ring_rcv(void* msg_ring_data, void** msg_obj)
+{
+   if( msg_ring_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_ring_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   if( msg_obj == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_ring* p_ring = (msg_ring*)msg_ring_data;
+
+   for (;;)
+   {
+      if( atomic_load_explicit(&p_ring->unblocked, memory_order_acquire) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      if( ring_take(p_ring, msg_obj) )
+         break;
+
+      /* Announce the sleep, then look once more before actually sleeping. */
+      atomic_store(&p_ring->sleeping, 1);
+      atomic_thread_fence(memory_order_seq_cst);
+      if( ring_take(p_ring, msg_obj) )
+      {
+         atomic_store(&p_ring->sleeping, 0);
+         break;
+      }
+      if( !atomic_load(&p_ring->unblocked) )
+         futex_wait(&p_ring->sleeping, 1);
+      atomic_store(&p_ring->sleeping, 0);
+   }
+
+   atomic_fetch_sub_explicit(&p_ring->depth, 1, memory_order_relaxed);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_ring_flush
+
+  ===========================================================================*/
+msq_q_err_type msg_ring_flush(void* msg_ring_data)
+{
+   void* msg_obj;
+
+   if( msg_ring_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_ring_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   msg_ring* p_ring = (msg_ring*)msg_ring_data;
+
+   LOC_LOGD("%s: Flushing Message Ring\n", __FUNCTION__);
+
+   while( ring_pop(p_ring, &msg_obj) )
+   {
+      atomic_fetch_sub_explicit(&p_ring->depth, 1, memory_order_relaxed);
+      if( p_ring->dealloc )
+         p_ring->dealloc(msg_obj);
+   }
+
+   pthread_mutex_lock(&p_ring->overflow_mutex);
+   linked_list_flush(p_ring->overflow);
+   atomic_store_explicit(&p_ring->overflowing, 0, memory_order_relaxed);
+   atomic_store_explicit(&p_ring->depth, 0, memory_order_relaxed);
+   pthread_mutex_unlock(&p_ring->overflow_mutex);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_ring_unblock
+
+  ===========================================================================*/
+msq_q_err_type msg_ring_unblock(void* msg_ring_data)
+{
+   if( msg_ring_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_ring_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   msg_ring* p_ring = (msg_ring*)msg_ring_data;
+
+   if( atomic_exchange(&p_ring->unblocked, 1) )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   LOC_LOGD("%s: Unblocking Message Ring\n", __FUNCTION__);
+   atomic_store(&p_ring->sleeping, 0);
+   futex_wake(&p_ring->sleeping, INT_MAX);
+
+   return eMSG_Q_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_ring_depth
+
+  ===========================================================================*/
+msq_q_err_type msg_ring_depth(void* msg_ring_data, size_t* depth, size_t* high_water_mark)
+{
+   if( msg_ring_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_ring_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   msg_ring* p_ring = (msg_ring*)msg_ring_data;
+
+   if( depth )
+      *depth = atomic_load_explicit(&p_ring->depth, memory_order_relaxed);
+   if( high_water_mark )
+      *high_water_mark = atomic_load_explicit(&p_ring->high_water_mark, memory_order_relaxed);
+
+   return eMSG_Q_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/* Copyright (c) 2026, The LineageOS Project. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __MSG_RING_H__
+#define __MSG_RING_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <stddef.h>
+#include <msg_q.h>
+
+/*
+ * A message queue for any number of senders and a single receiver. Messages
+ * go into a fixed size ring without locks or allocations, and the receiver
+ * only costs the senders a futex wake when it is asleep. If the ring fills
+ * up, messages spill into a locked overflow list in order, so sending never
+ * blocks or fails, even from the receiving thread itself.
+ *
+ * Return codes are shared with msg_q.
+ */
+
+/*===========================================================================
+FUNCTION    msg_ring_init
+
+DESCRIPTION
+   Creates a message queue.
+
+   size:       Number of ring slots; rounded up to a power of two.
+   dealloc:    Function used to deallocate messages left in the queue when it
+               is flushed. Pass NULL if messages should not be deallocated.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   opaque handle to the queue created; NULL if create fails
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void* msg_ring_init(size_t size, void (*dealloc)(void*));
+
+/*===========================================================================
+FUNCTION    msg_ring_destroy
+
+DESCRIPTION
+   Releases the queue. Messages still queued are deallocated.
+
+   msg_ring_data: Queue to be released; set to NULL.
+
+DEPENDENCIES
+   No thread may be using the queue.
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_ring_destroy(void** msg_ring_data);
+
+/*===========================================================================
+FUNCTION    msg_ring_snd
+
+DESCRIPTION
+   Adds a message to the queue. Ownership of msg_obj passes to the queue,
+   and from it to the receiver.
+
+   msg_ring_data: Queue to add the message to.
+   msg_obj:       Message; must not be NULL.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_ring_snd(void* msg_ring_data, void* msg_obj);
+
+/*===========================================================================
+FUNCTION    msg_ring_rcv
+
+DESCRIPTION
+   Removes the oldest message from the queue, sleeping until one arrives.
+
+   msg_ring_data: Queue to receive from.
+   msg_obj:       Set to the message received.
+
+DEPENDENCIES
+   Only one thread may receive from a queue.
+
+RETURN VALUE
+   Look at error codes above. Fails once the queue has been unblocked.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_ring_rcv(void* msg_ring_data, void** msg_obj);
+
+/*===========================================================================
+FUNCTION    msg_ring_flush
+
+DESCRIPTION
+   Removes and deallocates all messages in the queue.
+
+   msg_ring_data: Queue to flush.
+
+DEPENDENCIES
+   Must not run concurrently with msg_ring_rcv.
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_ring_flush(void* msg_ring_data);
+
+/*===========================================================================
+FUNCTION    msg_ring_unblock
+
+DESCRIPTION
+   Stops the queue: the receiver wakes up and fails, and so do further sends.
+
+   msg_ring_data: Queue to unblock.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_ring_unblock(void* msg_ring_data);
+
+/*===========================================================================
+FUNCTION    msg_ring_depth
+
+DESCRIPTION
+   Reports how many messages are queued, and the most there have ever been.
+
+   msg_ring_data:   Queue to query.
+   depth:           Set to the current number of messages; may be NULL.
+   high_water_mark: Set to the largest number of messages seen; may be NULL.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_ring_depth(void* msg_ring_data, size_t* depth, size_t* high_water_mark);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __MSG_RING_H__ */
@@ -17,6 +17,16 @@
 #define LOG_TAG "android.hardware.light-service.hh"
 #include <android-base/logging.h>
 
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
 #include "Lights.h"
 
 namespace aidl {
@@ -48,16 +58,32 @@ static const HwLight kNotificationHwLight = {
     .ordinal = 0
 };
 
-Lights::Lights(std::ofstream&& backlight,
-               std::ofstream&& rLedBrightness,
-               std::ofstream&& gLedBrightness,
-               std::ofstream&& bLedBrightness,
-               std::ofstream&& rLedTimeout,
-               std::ofstream&& gLedTimeout,
-               std::ofstream&& bLedTimeout,
-               std::ofstream&& rLedLocked,
-               std::ofstream&& gLedLocked,
-               std::ofstream&& bLedLocked) :
+/* The panel refreshes at 60 Hz; faster backlight updates are never seen. */
+static constexpr int64_t kBacklightMinIntervalNs = 16666667;
+
+/* LED patterns are rendered at up to 40 frames per second... */
+static constexpr uint32_t kFrameMs = 25;
+/* ...and at most this many steps per ramp, however long. */
+static constexpr uint32_t kMaxRampSteps = 64;
+
+static int64_t nowNs() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+Lights::Lights(unique_fd&& backlight,
+               unique_fd&& rLedBrightness,
+               unique_fd&& gLedBrightness,
+               unique_fd&& bLedBrightness,
+               unique_fd&& rLedTimeout,
+               unique_fd&& gLedTimeout,
+               unique_fd&& bLedTimeout,
+               unique_fd&& rLedLocked,
+               unique_fd&& gLedLocked,
+               unique_fd&& bLedLocked,
+               bool softwarePatterns) :
                mBacklight(std::move(backlight)),
                mRLedBrightness(std::move(rLedBrightness)),
                mGLedBrightness(std::move(gLedBrightness)),
@@ -67,7 +93,27 @@ Lights::Lights(std::ofstream&& backlight,
                mBLedTimeout(std::move(bLedTimeout)),
                mRLedLocked(std::move(rLedLocked)),
                mGLedLocked(std::move(gLedLocked)),
-               mBLedLocked(std::move(bLedLocked)) {
+               mBLedLocked(std::move(bLedLocked)),
+               mBacklightPending(0),
+               mBacklightFlushPending(false),
+               mBacklightNextWriteNs(0),
+               mBacklightTimer(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+               mDisplayOn(true),
+               mSoftwarePatterns(softwarePatterns),
+               mFrameIndex(0),
+               mFrameDeadlineNs(0),
+               mAnimationTimer(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+               mExitEvent(eventfd(0, EFD_CLOEXEC)) {
+    if (mBacklightTimer < 0 || mAnimationTimer < 0 || mExitEvent < 0)
+        PLOG(ERROR) << "Failed to create light timers";
+    mThread = std::thread(&Lights::eventLoop, this);
+}
+
+Lights::~Lights() {
+    uint64_t one = 1;
+
+    TEMP_FAILURE_RETRY(write(mExitEvent.get(), &one, sizeof(one)));
+    mThread.join();
 }
 
 ndk::ScopedAStatus Lights::setLightState(int32_t id, const HwLightState& state) {
@@ -114,8 +160,28 @@ void Lights::setAttentionLight(const HwLightState& state) {
 
 void Lights::setBacklightLight(const HwLightState& state) {
     std::lock_guard<std::mutex> lock(mLock);
-    uint32_t brightness = rgbToBrightness(state);
-    mBacklight << brightness << std::endl;
+    mBacklightPending = rgbToBrightness(state);
+
+    if (nowNs() >= mBacklightNextWriteNs) {
+        writeBacklightLocked();
+    } else if (!mBacklightFlushPending) {
+        mBacklightFlushPending = true;
+        armTimer(mBacklightTimer, mBacklightNextWriteNs);
+    }
+
+    /* Software patterns only run with the display on; switch to or from hardware blinking. */
+    if (mDisplayOn != (mBacklightPending > 0)) {
+        mDisplayOn = mBacklightPending > 0;
+        if (mSoftwarePatterns) setPrioritizedLightLocked();
+    }
+}
+
+void Lights::writeBacklightLocked() {
+    char buf[16];
+
+    mBacklightFlushPending = false;
+    snprintf(buf, sizeof(buf), "%u\n", mBacklightPending);
+    if (writeNode(mBacklight, buf)) mBacklightNextWriteNs = nowNs() + kBacklightMinIntervalNs;
 }
 
 void Lights::setBatteryLight(const HwLightState& state) {
@@ -132,6 +198,7 @@ void Lights::setPrioritizedLightLocked() {
     } else if (isLit(mBatteryState)) {
         setLightStateLocked(mBatteryState);
     } else {
+        stopAnimationLocked();
         setLightLocked(0, 0, 0);
     }
 }
@@ -140,6 +207,27 @@ void Lights::setLightStateLocked(const HwLightState& state) {
     int onMS, offMS;
     uint32_t color = state.color & 0x00ffffff;
 
+    /*
+     * With software patterns enabled and the display on, timed flashing
+     * breathes: ramp up over the first half of the on time, down over the
+     * second, then stay dark for the off time. Otherwise, and always for
+     * HARDWARE, the LED controller blinks on its own so the CPU can sleep.
+     */
+    if (mSoftwarePatterns && mDisplayOn && state.flashMode == FlashMode::TIMED &&
+        state.flashOnMs > 0 && state.flashOffMs > 0) {
+        if (!mFrames.empty() && mAnimationState.color == state.color &&
+            mAnimationState.flashOnMs == state.flashOnMs &&
+            mAnimationState.flashOffMs == state.flashOffMs)
+            return;
+
+        uint32_t rampMs = std::max<uint32_t>(state.flashOnMs / 2, 1);
+        mAnimationState = state;
+        startAnimationLocked({{color, rampMs}, {0, rampMs}, {0, (uint32_t)state.flashOffMs}});
+        return;
+    }
+
+    stopAnimationLocked();
+
     switch (state.flashMode) {
         case FlashMode::TIMED:
         case FlashMode::HARDWARE:
@@ -160,22 +248,191 @@ void Lights::setLightLocked(uint32_t color, int onMS, int offMS) {
     uint32_t r = ((color >> 16) & 0xff);
     uint32_t g = ((color >> 8) & 0xff);
     uint32_t b = ((color) & 0xff);
+    char rBuf[16], gBuf[16], bBuf[16], timeoutBuf[32];
+
+    snprintf(rBuf, sizeof(rBuf), "%u\n", r);
+    snprintf(gBuf, sizeof(gBuf), "%u\n", g);
+    snprintf(bBuf, sizeof(bBuf), "%u\n", b);
+    snprintf(timeoutBuf, sizeof(timeoutBuf), "%d %d\n", onMS, offMS);
+
+    /* Re-sending the same pattern would only restart it. */
+    if (nodeHolds(mRLedBrightness, rBuf) && nodeHolds(mGLedBrightness, gBuf) &&
+        nodeHolds(mBLedBrightness, bBuf) && nodeHolds(mRLedTimeout, timeoutBuf) &&
+        nodeHolds(mGLedTimeout, timeoutBuf) && nodeHolds(mBLedTimeout, timeoutBuf))
+        return;
+
+    /* Hold the pattern while the changed channels are updated, then restart it. */
+    writeNode(mRLedLocked, "0\n", true);
+    writeNode(mGLedLocked, "0\n", true);
+    writeNode(mBLedLocked, "0\n", true);
+
+    writeNode(mRLedBrightness, rBuf);
+    writeNode(mGLedBrightness, gBuf);
+    writeNode(mBLedBrightness, bBuf);
+
+    writeNode(mRLedTimeout, timeoutBuf);
+    writeNode(mGLedTimeout, timeoutBuf);
+    writeNode(mBLedTimeout, timeoutBuf);
+
+    writeNode(mRLedLocked, "1\n", true);
+    writeNode(mGLedLocked, "1\n", true);
+    writeNode(mBLedLocked, "1\n", true);
+}
 
-    mRLedLocked << 0 << std::endl;
-    mGLedLocked << 0 << std::endl;
-    mBLedLocked << 0 << std::endl;
+static uint32_t lerpColor(uint32_t from, uint32_t to, uint32_t step, uint32_t steps) {
+    uint32_t color = 0;
 
-    mRLedBrightness << r << std::endl;
-    mGLedBrightness << g << std::endl;
-    mBLedBrightness << b << std::endl;
+    for (int shift = 0; shift <= 16; shift += 8) {
+        int a = (from >> shift) & 0xff, b = (to >> shift) & 0xff;
+        color |= (uint32_t)(a + (b - a) * (int)step / (int)steps) << shift;
+    }
+    return color;
+}
+
+/*
+ * Expands keyframes into the frames actually shown, one per kFrameMs tick
+ * of each ramp. Consecutive identical colors are merged so holds cost a
+ * single timer wakeup. The pattern loops, so the first ramp starts from
+ * the last keyframe's color.
+ */
+std::vector<Lights::Frame> Lights::renderFrames(const std::vector<Keyframe>& keyframes) {
+    std::vector<Frame> frames;
+    uint32_t prev = keyframes.back().color;
+
+    for (const Keyframe& key : keyframes) {
+        uint32_t steps =
+                std::clamp<uint32_t>(key.durationMs / kFrameMs, 1, prev == key.color ? 1 : kMaxRampSteps);
+
+        for (uint32_t i = 1; i <= steps; i++) {
+            uint32_t color = lerpColor(prev, key.color, i, steps);
+            uint32_t durationMs = key.durationMs * i / steps - key.durationMs * (i - 1) / steps;
+
+            if (!frames.empty() && frames.back().color == color)
+                frames.back().durationMs += durationMs;
+            else
+                frames.push_back({color, durationMs});
+        }
+        prev = key.color;
+    }
 
-    mRLedTimeout << onMS << " " << offMS << std::endl;
-    mGLedTimeout << onMS << " " << offMS << std::endl;
-    mBLedTimeout << onMS << " " << offMS << std::endl;
+    if (frames.size() > 1 && frames.front().color == frames.back().color) {
+        frames.front().durationMs += frames.back().durationMs;
+        frames.pop_back();
+    }
+    return frames;
+}
+
+void Lights::startAnimationLocked(const std::vector<Keyframe>& keyframes) {
+    mFrames = renderFrames(keyframes);
+    mFrameIndex = 0;
+
+    /* Steady mode, so brightness writes show up directly. */
+    setLightLocked(mFrames[0].color, 0, 0);
+
+    if (mFrames.size() > 1) {
+        mFrameDeadlineNs = nowNs() + mFrames[0].durationMs * 1000000LL;
+        armTimer(mAnimationTimer, mFrameDeadlineNs);
+    }
+}
+
+void Lights::stopAnimationLocked() {
+    if (mFrames.empty()) return;
+
+    mFrames.clear();
+    armTimer(mAnimationTimer, 0);
+}
+
+/* One tick: only the channels that changed are written. */
+void Lights::showFrameLocked() {
+    uint32_t color = mFrames[mFrameIndex].color;
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%u\n", (color >> 16) & 0xff);
+    writeNode(mRLedBrightness, buf);
+    snprintf(buf, sizeof(buf), "%u\n", (color >> 8) & 0xff);
+    writeNode(mGLedBrightness, buf);
+    snprintf(buf, sizeof(buf), "%u\n", color & 0xff);
+    writeNode(mBLedBrightness, buf);
+}
+
+void Lights::advanceAnimationLocked() {
+    int64_t now = nowNs();
+
+    if (mFrames.size() < 2) return;
+
+    /* Skip frames we slept through rather than replaying them late. */
+    do {
+        mFrameIndex = (mFrameIndex + 1) % mFrames.size();
+        mFrameDeadlineNs += mFrames[mFrameIndex].durationMs * 1000000LL;
+    } while (mFrameDeadlineNs <= now);
+
+    showFrameLocked();
+    armTimer(mAnimationTimer, mFrameDeadlineNs);
+}
+
+/* Arms 'timer' for the absolute CLOCK_MONOTONIC time 'deadlineNs', or disarms it for 0. */
+void Lights::armTimer(const unique_fd& timer, int64_t deadlineNs) {
+    struct itimerspec spec = {};
+
+    if (deadlineNs) {
+        spec.it_value.tv_sec = deadlineNs / 1000000000LL;
+        spec.it_value.tv_nsec = deadlineNs % 1000000000LL;
+    }
+    if (timerfd_settime(timer.get(), TFD_TIMER_ABSTIME, &spec, nullptr))
+        PLOG(ERROR) << "Failed to arm light timer";
+}
+
+/* The only thread the HAL owns; it blocks in poll() with no timeout. */
+void Lights::eventLoop() {
+    struct pollfd fds[] = {
+        {mExitEvent.get(), POLLIN, 0},
+        {mBacklightTimer.get(), POLLIN, 0},
+        {mAnimationTimer.get(), POLLIN, 0},
+    };
+    uint64_t expirations;
+
+    while (true) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            PLOG(ERROR) << "Light event loop failed";
+            return;
+        }
+        if (fds[0].revents) return;
+
+        std::lock_guard<std::mutex> lock(mLock);
+
+        if (fds[1].revents && read(mBacklightTimer.get(), &expirations, sizeof(expirations)) > 0 &&
+            mBacklightFlushPending)
+            writeBacklightLocked();
+        if (fds[2].revents && read(mAnimationTimer.get(), &expirations, sizeof(expirations)) > 0)
+            advanceAnimationLocked();
+    }
+}
+
+bool Lights::nodeHolds(const Node& node, const char* value) {
+    return strlen(value) == node.len && !memcmp(value, node.shadow, node.len);
+}
+
+/*
+ * Writes a pre-formatted value with a single write(), skipping it if the
+ * node already holds it unless 'force' is set (for trigger nodes, where
+ * the write itself is the event). Returns true if the node was written.
+ */
+bool Lights::writeNode(Node& node, const char* value, bool force) {
+    size_t len = strlen(value);
+
+    if (len >= sizeof(node.shadow)) return false;
+    if (!force && nodeHolds(node, value)) return false;
+
+    if (TEMP_FAILURE_RETRY(write(node.fd.get(), value, len)) != (ssize_t)len) {
+        PLOG(ERROR) << "Failed to write " << value;
+        node.len = 0;
+        return false;
+    }
 
-    mRLedLocked << 1 << std::endl;
-    mGLedLocked << 1 << std::endl;
-    mBLedLocked << 1 << std::endl;
+    memcpy(node.shadow, value, len);
+    node.len = len;
+    return true;
 }
 
 bool Lights::isLit(const HwLightState& state) {
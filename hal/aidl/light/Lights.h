@@ -17,31 +17,58 @@
 #pragma once
 
 #include <aidl/android/hardware/light/BnLights.h>
-#include <fstream>
+#include <android-base/unique_fd.h>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 namespace aidl {
 namespace android {
 namespace hardware {
 namespace light {
 
+using ::android::base::unique_fd;
+
 class Lights : public BnLights {
 public:
-    Lights(std::ofstream&& backlight,
-           std::ofstream&& rLedBrightness,
-           std::ofstream&& gLedBrightness,
-           std::ofstream&& bLedBrightness,
-           std::ofstream&& rLedTimeout,
-           std::ofstream&& gLedTimeout,
-           std::ofstream&& bLedTimeout,
-           std::ofstream&& rLedLocked,
-           std::ofstream&& gLedLocked,
-           std::ofstream&& bLedLocked);
+    Lights(unique_fd&& backlight,
+           unique_fd&& rLedBrightness,
+           unique_fd&& gLedBrightness,
+           unique_fd&& bLedBrightness,
+           unique_fd&& rLedTimeout,
+           unique_fd&& gLedTimeout,
+           unique_fd&& bLedTimeout,
+           unique_fd&& rLedLocked,
+           unique_fd&& gLedLocked,
+           unique_fd&& bLedLocked,
+           bool softwarePatterns);
+    ~Lights();
 
     ndk::ScopedAStatus setLightState(int32_t id, const HwLightState& state) override;
     ndk::ScopedAStatus getLights(std::vector<HwLight> *_aidl_return) override;
 
 private:
+    /* A sysfs node and the last value written to it. */
+    struct Node {
+        explicit Node(unique_fd&& fd) : fd(std::move(fd)) {}
+
+        unique_fd fd;
+        char shadow[24];
+        size_t len = 0;
+    };
+
+    /* Ramp from the previous keyframe's color to 'color' over 'durationMs'. */
+    struct Keyframe {
+        uint32_t color;
+        uint32_t durationMs;
+    };
+
+    /* A pre-rendered color, shown for 'durationMs'. */
+    struct Frame {
+        uint32_t color;
+        uint32_t durationMs;
+    };
+
     void setNotificationLight(const HwLightState& state);
     void setAttentionLight(const HwLightState& state);
     void setBacklightLight(const HwLightState& state);
@@ -51,25 +78,66 @@ private:
     void setLightStateLocked(const HwLightState& state);
     void setLightLocked(uint32_t color, int onMS, int offMS);
 
+    void writeBacklightLocked();
+
+    static std::vector<Frame> renderFrames(const std::vector<Keyframe>& keyframes);
+    void startAnimationLocked(const std::vector<Keyframe>& keyframes);
+    void stopAnimationLocked();
+    void showFrameLocked();
+    void advanceAnimationLocked();
+
+    void eventLoop();
+    void armTimer(const unique_fd& timer, int64_t deadlineNs);
+
+    bool nodeHolds(const Node& node, const char* value);
+    bool writeNode(Node& node, const char* value, bool force = false);
+
     bool isLit(const HwLightState& state);
     uint32_t rgbToBrightness(const HwLightState& state);
 
-    std::ofstream mBacklight;
-    std::ofstream mRLedBrightness;
-    std::ofstream mGLedBrightness;
-    std::ofstream mBLedBrightness;
-    std::ofstream mRLedTimeout;
-    std::ofstream mGLedTimeout;
-    std::ofstream mBLedTimeout;
-    std::ofstream mRLedLocked;
-    std::ofstream mGLedLocked;
-    std::ofstream mBLedLocked;
+    Node mBacklight;
+    Node mRLedBrightness;
+    Node mGLedBrightness;
+    Node mBLedBrightness;
+    Node mRLedTimeout;
+    Node mGLedTimeout;
+    Node mBLedTimeout;
+    Node mRLedLocked;
+    Node mGLedLocked;
+    Node mBLedLocked;
 
     HwLightState mNotificationState;
     HwLightState mAttentionState;
     HwLightState mBatteryState;
 
+    /*
+     * Backlight writes are limited to one per display refresh; a value
+     * arriving sooner is written when mBacklightTimer fires.
+     */
+    uint32_t mBacklightPending;
+    bool mBacklightFlushPending;
+    int64_t mBacklightNextWriteNs;
+    unique_fd mBacklightTimer;
+
+    /* Whether the last backlight value was non-zero. */
+    bool mDisplayOn;
+
+    /*
+     * Software LED pattern, used only when mSoftwarePatterns is set and the
+     * display is on. mAnimationTimer is only armed while a pattern with
+     * more than one frame is running, so an idle HAL never wakes up.
+     */
+    const bool mSoftwarePatterns;
+    std::vector<Frame> mFrames;
+    size_t mFrameIndex;
+    int64_t mFrameDeadlineNs;
+    HwLightState mAnimationState;
+    unique_fd mAnimationTimer;
+
+    unique_fd mExitEvent;
+
     std::mutex mLock;
+    std::thread mThread;
 };
 
 } // namespace light
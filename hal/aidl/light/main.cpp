@@ -16,13 +16,17 @@
 
 #define LOG_TAG "android.hardware.light-service.hh"
 #include <android-base/logging.h>
+#include <android-base/properties.h>
 
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
+#include <fcntl.h>
+
 #include "Lights.h"
 
 using ::aidl::android::hardware::light::Lights;
+using ::android::base::unique_fd;
 
 const static std::string kBacklightPath = "/sys/class/leds/lcd-backlight/brightness";
 
@@ -38,63 +42,66 @@ const static std::string kRLedLockedPath = "/sys/class/leds/red/rgb_start";
 const static std::string kGLedLockedPath = "/sys/class/leds/green/rgb_start";
 const static std::string kBLedLockedPath = "/sys/class/leds/blue/rgb_start";
 
+/* Breathe timed notifications in software while the display is on. */
+const static std::string kSoftwarePatternsProp = "ro.vendor.light.sw_patterns";
+
 std::shared_ptr<Lights> createLightsService() {
-    std::ofstream backlight(kBacklightPath);
-    if (!backlight) {
+    unique_fd backlight(open(kBacklightPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (backlight < 0) {
         LOG(ERROR) << "Failed to open " << kBacklightPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream rLedBrightness(kRLedBrightnessPath);
-    if (!rLedBrightness) {
+    unique_fd rLedBrightness(open(kRLedBrightnessPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (rLedBrightness < 0) {
         LOG(ERROR) << "Failed to open " << kRLedBrightnessPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream gLedBrightness(kGLedBrightnessPath);
-    if (!gLedBrightness) {
+    unique_fd gLedBrightness(open(kGLedBrightnessPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (gLedBrightness < 0) {
         LOG(ERROR) << "Failed to open " << kGLedBrightnessPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream bLedBrightness(kBLedBrightnessPath);
-    if (!bLedBrightness) {
+    unique_fd bLedBrightness(open(kBLedBrightnessPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (bLedBrightness < 0) {
         LOG(ERROR) << "Failed to open " << kBLedBrightnessPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream rLedTimeout(kRLedTimeoutPath);
-    if (!rLedTimeout) {
+    unique_fd rLedTimeout(open(kRLedTimeoutPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (rLedTimeout < 0) {
         LOG(ERROR) << "Failed to open " << kRLedTimeoutPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream gLedTimeout(kGLedTimeoutPath);
-    if (!gLedTimeout) {
+    unique_fd gLedTimeout(open(kGLedTimeoutPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (gLedTimeout < 0) {
         LOG(ERROR) << "Failed to open " << kGLedTimeoutPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream bLedTimeout(kBLedTimeoutPath);
-    if (!bLedTimeout) {
+    unique_fd bLedTimeout(open(kBLedTimeoutPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (bLedTimeout < 0) {
         LOG(ERROR) << "Failed to open " << kBLedTimeoutPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream rLedLocked(kRLedLockedPath);
-    if (!rLedLocked) {
+    unique_fd rLedLocked(open(kRLedLockedPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (rLedLocked < 0) {
         LOG(ERROR) << "Failed to open " << kRLedLockedPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream gLedLocked(kGLedLockedPath);
-    if (!gLedLocked) {
+    unique_fd gLedLocked(open(kGLedLockedPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (gLedLocked < 0) {
         LOG(ERROR) << "Failed to open " << kGLedLockedPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
 
-    std::ofstream bLedLocked(kBLedLockedPath);
-    if (!bLedLocked) {
+    unique_fd bLedLocked(open(kBLedLockedPath.c_str(), O_WRONLY | O_CLOEXEC));
+    if (bLedLocked < 0) {
         LOG(ERROR) << "Failed to open " << kBLedLockedPath << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
@@ -108,7 +115,8 @@ std::shared_ptr<Lights> createLightsService() {
                                             std::move(bLedTimeout),
                                             std::move(rLedLocked),
                                             std::move(gLedLocked),
-                                            std::move(bLedLocked));
+                                            std::move(bLedLocked),
+                                            ::android::base::GetBoolProperty(kSoftwarePatternsProp, false));
 }
 
 int main() {
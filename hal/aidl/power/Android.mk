@@ -20,8 +20,12 @@ LOCAL_SRC_FILES := \
     power-common.c \
     metadata-parser.c \
     utils.c \
-    list.c \
     hint-data.c \
+    hint-config.c \
+    hint-stats.c \
+    perflock.c \
+    timer-wheel.c \
+    HintDispatcher.cpp \
     Power.cpp \
     main.cpp
 
@@ -46,3 +50,5 @@ LOCAL_VENDOR_MODULE := true
 LOCAL_VINTF_FRAGMENTS := android.hardware.power-service.hh.xml
 
 include $(BUILD_EXECUTABLE)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
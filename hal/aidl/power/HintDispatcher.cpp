@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_TAG "android.hardware.power-service.hh"
+
+#include "HintDispatcher.h"
+
+#include <android-base/logging.h>
+#include <pthread.h>
+
+#include <algorithm>
+
+#include "hint-stats.h"
+#include "power-common.h"
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+HintDispatcher::HintDispatcher()
+    : mTail(0), mHead(0), mSleeping(false), mExit(false), mLaunchActive(false) {
+    for (size_t i = 0; i < kQueueSize; i++) mCells[i].seq.store(i, std::memory_order_relaxed);
+
+    mThread = std::thread(&HintDispatcher::run, this);
+    pthread_setname_np(mThread.native_handle(), "power-hints");
+}
+
+HintDispatcher::~HintDispatcher() {
+    mExit = true;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mSleeping = false;
+    }
+    mWakeup.notify_one();
+    mThread.join();
+}
+
+void HintDispatcher::post(Type type, int32_t value, int32_t id) {
+    Hint hint = {type, value, id, hint_stats_now_ns()};
+
+    if (!push(hint)) {
+        /* Only reachable if the worker is wedged; wait rather than run hints concurrently. */
+        LOG(WARNING) << "Hint queue full, waiting to post hint " << static_cast<int>(type);
+        while (!push(hint)) std::this_thread::yield();
+    }
+
+    if (mSleeping.exchange(false)) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mWakeup.notify_one();
+    }
+}
+
+bool HintDispatcher::push(const Hint& hint) {
+    size_t pos = mTail.load(std::memory_order_relaxed);
+    Cell* cell;
+
+    for (;;) {
+        cell = &mCells[pos % kQueueSize];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+            if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = mTail.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->hint = hint;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool HintDispatcher::pop(Hint* hint) {
+    Cell* cell = &mCells[mHead % kQueueSize];
+
+    if (cell->seq.load(std::memory_order_acquire) != mHead + 1) return false;
+
+    *hint = cell->hint;
+    cell->seq.store(mHead + kQueueSize, std::memory_order_release);
+    mHead++;
+    return true;
+}
+
+void HintDispatcher::run() {
+    Hint batch[kMaxBatch];
+
+    while (!mExit) {
+        size_t count = 0;
+
+        while (count < kMaxBatch && pop(&batch[count])) count++;
+
+        if (count) {
+            dispatch(batch, count);
+            continue;
+        }
+
+        /*
+         * Announce that we are going idle, then re-check to avoid a lost
+         * wakeup; the destructor may have cleared mSleeping before we set it.
+         */
+        mSleeping = true;
+        if (mExit) break;
+        Hint hint;
+        if (pop(&hint)) {
+            mSleeping = false;
+            dispatch(&hint, 1);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        mWakeup.wait(lock, [this] { return !mSleeping || mExit; });
+    }
+}
+
+void HintDispatcher::dispatch(const Hint* batch, size_t count) {
+    size_t i = 0;
+
+    while (i < count) {
+        size_t end = i;
+
+        while (end < count &&
+               (batch[end].type == Type::INTERACTION || batch[end].type == Type::LAUNCH))
+            end++;
+
+        if (end > i) {
+            coalesce(batch + i, end - i);
+            i = end;
+        } else {
+            apply(batch[i++]);
+        }
+    }
+}
+
+/* 'batch' holds only INTERACTION and LAUNCH hints. */
+void HintDispatcher::coalesce(const Hint* batch, size_t count) {
+    int32_t interactionMs = 0;
+    uint64_t interactionPostedNs = UINT64_MAX;
+    size_t lastInteraction = count, lastLaunch = count;
+    bool launchSeenOff = false;
+
+    for (size_t i = 0; i < count; i++) {
+        if (batch[i].type == Type::INTERACTION) {
+            interactionMs = std::max(interactionMs, batch[i].value);
+            interactionPostedNs = std::min(interactionPostedNs, batch[i].postedNs);
+            lastInteraction = i;
+        } else if (batch[i].type == Type::LAUNCH) {
+            launchSeenOff |= !batch[i].value;
+            lastLaunch = i;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (i == lastInteraction) {
+            /* Latency of a merged boost is counted from the oldest request it covers. */
+            apply({Type::INTERACTION, interactionMs, 0, interactionPostedNs});
+        } else if (i == lastLaunch) {
+            bool on = batch[i].value;
+            bool applied = false;
+
+            /* Only an off in between renews a launch boost that is already held. */
+            if (mLaunchActive && (!on || launchSeenOff)) {
+                apply({Type::LAUNCH, false, 0, batch[i].postedNs});
+                applied = true;
+            }
+            if (on && (!mLaunchActive || launchSeenOff)) {
+                apply({Type::LAUNCH, true, 0, batch[i].postedNs});
+                applied = true;
+            }
+            if (!applied) hint_stats_coalesced(STAT_LAUNCH);
+            mLaunchActive = on;
+        } else if (batch[i].type == Type::INTERACTION) {
+            hint_stats_coalesced(STAT_INTERACTION);
+        } else {
+            hint_stats_coalesced(STAT_LAUNCH);
+        }
+    }
+}
+
+void HintDispatcher::apply(const Hint& hint) {
+    int32_t value = hint.value;
+    enum hint_stat_kind kind = STAT_INTERACTION;
+
+    switch (hint.type) {
+        case Type::INTERACTION:
+            power_hint(POWER_HINT_INTERACTION, &value);
+            kind = STAT_INTERACTION;
+            break;
+        case Type::LAUNCH:
+            power_hint(POWER_HINT_LAUNCH, value ? &value : NULL);
+            kind = STAT_LAUNCH;
+            break;
+        case Type::INTERACTIVE:
+            set_interactive(value ? 1 : 0);
+            kind = STAT_INTERACTIVE;
+            break;
+        case Type::SUSTAINED_PERFORMANCE:
+            power_hint(POWER_HINT_SUSTAINED_PERFORMANCE, NULL);
+            kind = STAT_SUSTAINED_PERFORMANCE;
+            break;
+        case Type::PROFILE:
+            power_profile(static_cast<enum power_profile>(hint.id), value);
+            kind = static_cast<enum hint_stat_kind>(STAT_PROFILE_BASE + hint.id);
+            break;
+    }
+
+    hint_stats_applied(kind, hint.postedNs);
+}
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
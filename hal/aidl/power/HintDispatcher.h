@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace aidl {
+namespace android {
+namespace hardware {
+namespace power {
+namespace impl {
+
+/*
+ * Runs power hints on a dedicated thread so binder calls only have to
+ * enqueue them. Hints queued while the worker is busy are coalesced:
+ * interaction boosts collapse into one boost of the longest duration, and
+ * launch on/off pairs that cancel out are dropped. Only back to back boosts
+ * are merged, so no hint moves across an INTERACTIVE or mode hint.
+ */
+class HintDispatcher {
+  public:
+    enum class Type : uint8_t {
+        INTERACTION,
+        LAUNCH,
+        INTERACTIVE,
+        SUSTAINED_PERFORMANCE,
+        PROFILE,
+    };
+
+    struct Hint {
+        Type type;
+        int32_t value;
+        /* enum power_profile for PROFILE hints. */
+        int32_t id;
+        /* hint_stats_now_ns() at post time, for latency accounting. */
+        uint64_t postedNs;
+    };
+
+    HintDispatcher();
+    ~HintDispatcher();
+
+    /* Lock-free unless the queue is full, in which case it waits for a slot. */
+    void post(Type type, int32_t value, int32_t id = 0);
+
+  private:
+    static constexpr size_t kQueueSize = 256;
+    static constexpr size_t kMaxBatch = 64;
+
+    struct Cell {
+        std::atomic<size_t> seq;
+        Hint hint;
+    };
+
+    bool push(const Hint& hint);
+    bool pop(Hint* hint);
+    void run();
+    void dispatch(const Hint* batch, size_t count);
+    void coalesce(const Hint* batch, size_t count);
+    void apply(const Hint& hint);
+
+    /* Bounded MPSC ring; producers claim slots with a CAS on mTail. */
+    Cell mCells[kQueueSize];
+    alignas(64) std::atomic<size_t> mTail;
+    alignas(64) size_t mHead;
+
+    std::atomic<bool> mSleeping;
+    std::atomic<bool> mExit;
+    std::mutex mLock;
+    std::condition_variable mWakeup;
+
+    /* Launch state last applied, only touched by the worker. */
+    bool mLaunchActive;
+
+    std::thread mThread;
+};
+
+}  // namespace impl
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+}  // namespace aidl
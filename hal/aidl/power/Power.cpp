@@ -31,6 +31,8 @@
 
 #include "Power.h"
 
+#include <unistd.h>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 
@@ -40,6 +42,8 @@
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
+#include "hint-stats.h"
+
 using ::aidl::android::hardware::power::BnPower;
 using ::aidl::android::hardware::power::Boost;
 using ::aidl::android::hardware::power::IPower;
@@ -54,15 +58,36 @@ namespace hardware {
 namespace power {
 namespace impl {
 
+static bool modeToProfile(Mode type, enum power_profile* profile) {
+    switch (type) {
+        case Mode::AUDIO_STREAMING_LOW_LATENCY:
+            *profile = PROFILE_AUDIO_LOW_LATENCY;
+            return true;
+        case Mode::CAMERA_STREAMING_LOW:
+            *profile = PROFILE_CAMERA_STREAMING_LOW;
+            return true;
+        case Mode::CAMERA_STREAMING_MID:
+            *profile = PROFILE_CAMERA_STREAMING_MID;
+            return true;
+        case Mode::CAMERA_STREAMING_HIGH:
+            *profile = PROFILE_CAMERA_STREAMING_HIGH;
+            return true;
+        case Mode::EXPENSIVE_RENDERING:
+            *profile = PROFILE_EXPENSIVE_RENDERING;
+            return true;
+        case Mode::VR:
+            *profile = PROFILE_VR;
+            return true;
+        default:
+            return false;
+    }
+}
+
 #ifdef MODE_EXT
 extern bool isDeviceSpecificModeSupported(Mode type, bool* _aidl_return);
 extern bool setDeviceSpecificMode(Mode type, bool enabled);
 #endif
 
-void setInteractive(bool interactive) {
-    set_interactive(interactive ? 1 : 0);
-}
-
 ndk::ScopedAStatus Power::setMode(Mode type, bool enabled) {
     LOG(INFO) << "Power setMode: " << static_cast<int32_t>(type) << " to: " << enabled;
 #ifdef MODE_EXT
@@ -70,6 +95,12 @@ ndk::ScopedAStatus Power::setMode(Mode type, bool enabled) {
         return ndk::ScopedAStatus::ok();
     }
 #endif
+    enum power_profile profile;
+    if (modeToProfile(type, &profile)) {
+        mDispatcher.post(HintDispatcher::Type::PROFILE, enabled, profile);
+        return ndk::ScopedAStatus::ok();
+    }
+
     switch (type) {
 #ifdef TAP_TO_WAKE_NODE
         case Mode::DOUBLE_TAP_TO_WAKE:
@@ -79,26 +110,20 @@ ndk::ScopedAStatus Power::setMode(Mode type, bool enabled) {
         case Mode::DOUBLE_TAP_TO_WAKE:
 #endif
         case Mode::LOW_POWER:
-        case Mode::EXPENSIVE_RENDERING:
         case Mode::DEVICE_IDLE:
         case Mode::DISPLAY_INACTIVE:
-        case Mode::AUDIO_STREAMING_LOW_LATENCY:
         case Mode::CAMERA_STREAMING_SECURE:
-        case Mode::CAMERA_STREAMING_LOW:
-        case Mode::CAMERA_STREAMING_MID:
-        case Mode::CAMERA_STREAMING_HIGH:
-        case Mode::VR:
             LOG(INFO) << "Mode " << static_cast<int32_t>(type) << "Not Supported";
             break;
         case Mode::LAUNCH:
-            power_hint(POWER_HINT_LAUNCH, enabled ? &enabled : NULL);
+            mDispatcher.post(HintDispatcher::Type::LAUNCH, enabled);
             break;
         case Mode::INTERACTIVE:
-            setInteractive(enabled);
+            mDispatcher.post(HintDispatcher::Type::INTERACTIVE, enabled);
             break;
         case Mode::SUSTAINED_PERFORMANCE:
         case Mode::FIXED_PERFORMANCE:
-            power_hint(POWER_HINT_SUSTAINED_PERFORMANCE, NULL);
+            mDispatcher.post(HintDispatcher::Type::SUSTAINED_PERFORMANCE, enabled);
             break;
         default:
             LOG(INFO) << "Mode " << static_cast<int32_t>(type) << "Not Supported";
@@ -124,6 +149,12 @@ ndk::ScopedAStatus Power::isModeSupported(Mode type, bool* _aidl_return) {
         case Mode::INTERACTIVE:
         case Mode::SUSTAINED_PERFORMANCE:
         case Mode::FIXED_PERFORMANCE:
+        case Mode::AUDIO_STREAMING_LOW_LATENCY:
+        case Mode::CAMERA_STREAMING_LOW:
+        case Mode::CAMERA_STREAMING_MID:
+        case Mode::CAMERA_STREAMING_HIGH:
+        case Mode::EXPENSIVE_RENDERING:
+        case Mode::VR:
             *_aidl_return = true;
             break;
         default:
@@ -138,7 +169,7 @@ ndk::ScopedAStatus Power::setBoost(Boost type, int32_t durationMs) {
                  << ", duration: " << durationMs;
     switch (type) {
         case Boost::INTERACTION:
-            power_hint(POWER_HINT_INTERACTION, &durationMs);
+            mDispatcher.post(HintDispatcher::Type::INTERACTION, durationMs);
             break;
         default:
             LOG(INFO) << "Boost " << static_cast<int32_t>(type) << "Not Supported";
@@ -160,6 +191,12 @@ ndk::ScopedAStatus Power::isBoostSupported(Boost type, bool* _aidl_return) {
     return ndk::ScopedAStatus::ok();
 }
 
+binder_status_t Power::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
+    hint_stats_dump(fd);
+    fsync(fd);
+    return STATUS_OK;
+}
+
 }  // namespace impl
 }  // namespace power
 }  // namespace hardware
@@ -31,6 +31,7 @@
 #define ANDROID_HARDWARE_POWER_POWER_H
 
 #include <aidl/android/hardware/power/BnPower.h>
+#include "HintDispatcher.h"
 #include "power-common.h"
 
 namespace aidl {
@@ -46,6 +47,10 @@ class Power : public BnPower {
     ndk::ScopedAStatus isModeSupported(Mode type, bool* _aidl_return) override;
     ndk::ScopedAStatus setBoost(Boost type, int32_t durationMs) override;
     ndk::ScopedAStatus isBoostSupported(Boost type, bool* _aidl_return) override;
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
+  private:
+    HintDispatcher mDispatcher;
 };
 
 }  // namespace impl
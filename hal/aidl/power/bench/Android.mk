@@ -0,0 +1,64 @@
+#
+# Copyright (C) 2026 The LineageOS Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+LOCAL_PATH := $(call my-dir)
+
+# Host benchmark for the power HAL hint path, e.g.:
+#   power-hint-bench -i 1000 $(LOCAL_PATH)/traces/*.trace
+# Put lib64/power-bench on LD_LIBRARY_PATH to bench against the qcopt stub.
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := power-hint-bench
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_SRC_FILES := \
+    power_bench.c \
+    ../power-common.c \
+    ../metadata-parser.c \
+    ../utils.c \
+    ../hint-data.c \
+    ../hint-config.c \
+    ../hint-stats.c \
+    ../perflock.c \
+    ../timer-wheel.c \
+    ../power-8974.c
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+LOCAL_HEADER_LIBRARIES := libhardware_headers
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+LOCAL_LDLIBS := -ldl -lpthread
+
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter -Wno-unused-variable
+# glibc has no strlcpy; libcutils provides it on the host.
+LOCAL_CFLAGS += -include cutils/memory.h
+
+# Match the device build, or interaction() compiles to nothing.
+ifeq ($(TARGET_USES_INTERACTION_BOOST),true)
+    LOCAL_CFLAGS += -DINTERACTION_BOOST
+endif
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libqti-perfd-client-bench-stub
+LOCAL_MODULE_STEM := libqti-perfd-client
+LOCAL_MODULE_RELATIVE_PATH := power-bench
+LOCAL_MODULE_HOST_OS := linux
+LOCAL_SRC_FILES := qcopt_stub.c
+LOCAL_CFLAGS := -Wall -Wextra -Werror -Wno-unused-parameter
+
+include $(BUILD_HOST_SHARED_LIBRARY)
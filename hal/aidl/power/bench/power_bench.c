@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Replays recorded hint traces through the power HAL against a fake
+ * sysfs tree and reports per-hint latency, throughput and allocations.
+ *
+ * Trace lines are "<delay_us> <hint> [args]":
+ *   interaction <ms> | launch <0|1> | interactive <0|1> | sustained
+ *   video_encode <metadata> | video_decode <metadata> | profile <name> <0|1>
+ *
+ * The native perflock engine is used unless a libqti-perfd-client.so is
+ * on the library path; bench/qcopt_stub.c builds one that does no work.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hint-data.h"
+#include "power-common.h"
+#include "utils.h"
+
+#define MAX_EVENTS 4096
+#define MAX_METADATA 128
+
+enum event_type {
+    EVENT_INTERACTION,
+    EVENT_LAUNCH,
+    EVENT_INTERACTIVE,
+    EVENT_SUSTAINED,
+    EVENT_VIDEO_ENCODE,
+    EVENT_VIDEO_DECODE,
+    EVENT_PROFILE,
+    NUM_EVENT_TYPES,
+};
+
+static const char* const event_names[NUM_EVENT_TYPES] = {
+        "interaction", "launch",       "interactive", "sustained",
+        "video_encode", "video_decode", "profile",
+};
+
+static const char* const profile_names[NUM_POWER_PROFILES] = {
+        [PROFILE_AUDIO_LOW_LATENCY] = "audio_low_latency",
+        [PROFILE_CAMERA_STREAMING_LOW] = "camera_streaming_low",
+        [PROFILE_CAMERA_STREAMING_MID] = "camera_streaming_mid",
+        [PROFILE_CAMERA_STREAMING_HIGH] = "camera_streaming_high",
+        [PROFILE_EXPENSIVE_RENDERING] = "expensive_rendering",
+        [PROFILE_VR] = "vr",
+};
+
+struct event {
+    unsigned int delay_us;
+    enum event_type type;
+    int value;
+    int profile;
+    char metadata[MAX_METADATA];
+};
+
+static struct event events[MAX_EVENTS];
+static int num_events;
+
+/* Latencies in ns, per event type, for every replayed event. */
+static unsigned long long* latencies[NUM_EVENT_TYPES];
+static size_t num_latencies[NUM_EVENT_TYPES];
+
+/*
+ * Allocation counting. glibc lets the executable interpose malloc and
+ * friends and reach the real allocator through the __libc_ entry points.
+ */
+static atomic_bool count_allocs;
+static atomic_ullong num_allocs;
+static atomic_ullong num_alloc_bytes;
+
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static void note_alloc(size_t size) {
+    if (!atomic_load_explicit(&count_allocs, memory_order_relaxed)) return;
+    atomic_fetch_add_explicit(&num_allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&num_alloc_bytes, size, memory_order_relaxed);
+}
+
+void* malloc(size_t size) {
+    note_alloc(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    note_alloc(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    note_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int write_node(const char* root, const char* node, const char* value) {
+    char path[PATH_MAX];
+    FILE* f;
+
+    snprintf(path, sizeof(path), "%s/%s", root, node);
+    for (char* p = strchr(path + strlen(root) + 1, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        if (mkdir(path, 0755) && errno != EEXIST) return -1;
+        *p = '/';
+    }
+
+    if (!(f = fopen(path, "w"))) return -1;
+    fprintf(f, "%s\n", value);
+    fclose(f);
+    return 0;
+}
+
+/* Populates the nodes the HAL and the native perflock engine touch. */
+static int make_fake_sysfs(const char* root, int soc_id) {
+    char node[PATH_MAX], value[16];
+    int ret = 0;
+
+    snprintf(value, sizeof(value), "%d", soc_id);
+    ret |= write_node(root, "devices/soc0/soc_id", value);
+
+    for (int cpu = 0; cpu < 4; cpu++) {
+        snprintf(node, sizeof(node), "devices/system/cpu/cpu%d/online", cpu);
+        ret |= write_node(root, node, cpu ? "0" : "1");
+        snprintf(node, sizeof(node), "devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+        ret |= write_node(root, node, "interactive");
+        snprintf(node, sizeof(node), "devices/system/cpu/cpu%d/cpufreq/scaling_min_freq", cpu);
+        ret |= write_node(root, node, "300000");
+        snprintf(node, sizeof(node), "devices/system/cpu/cpu%d/cpufreq/scaling_max_freq", cpu);
+        ret |= write_node(root, node, "2265600");
+        snprintf(node, sizeof(node), "devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        ret |= write_node(root, node, "2265600");
+    }
+
+    ret |= write_node(root, "devices/system/cpu/cpufreq/interactive/timer_rate", "20000");
+    ret |= write_node(root, "devices/system/cpu/cpufreq/interactive/hispeed_freq", "1190400");
+    ret |= write_node(root, "devices/system/cpu/cpufreq/interactive/go_hispeed_load", "99");
+    ret |= write_node(root, "devices/system/cpu/cpufreq/interactive/io_is_busy", "1");
+    ret |= write_node(root, "module/cpu_boost/parameters/sync_threshold", "0");
+
+    return ret;
+}
+
+static int remove_node(const char* path, const struct stat* st, int flag, struct FTW* ftw) {
+    return remove(path);
+}
+
+static int parse_event(char* line, struct event* event) {
+    char hint[32], arg[MAX_METADATA];
+    int fields;
+
+    memset(event, 0, sizeof(*event));
+    fields = sscanf(line, "%u %31s %127s %d", &event->delay_us, hint, arg, &event->value);
+    if (fields < 2) return -1;
+
+    for (int type = 0; type < NUM_EVENT_TYPES; type++) {
+        if (strcmp(hint, event_names[type])) continue;
+        event->type = type;
+
+        switch (event->type) {
+            case EVENT_SUSTAINED:
+                return 0;
+            case EVENT_VIDEO_ENCODE:
+            case EVENT_VIDEO_DECODE:
+                if (fields < 3) return -1;
+                strlcpy(event->metadata, arg, sizeof(event->metadata));
+                return 0;
+            case EVENT_PROFILE:
+                if (fields < 4) return -1;
+                for (int i = 0; i < NUM_POWER_PROFILES; i++) {
+                    if (!strcmp(arg, profile_names[i])) {
+                        event->profile = i;
+                        return 0;
+                    }
+                }
+                return -1;
+            default:
+                if (fields < 3) return -1;
+                event->value = atoi(arg);
+                return 0;
+        }
+    }
+    return -1;
+}
+
+static int load_trace(const char* path) {
+    char line[256];
+    int lineno = 0;
+    FILE* f = fopen(path, "r");
+
+    if (!f) {
+        fprintf(stderr, "Unable to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[strspn(line, " \t")] == '#' || line[strspn(line, " \t\n")] == '\0') continue;
+
+        if (num_events == MAX_EVENTS) {
+            fprintf(stderr, "%s: more than %d events\n", path, MAX_EVENTS);
+            break;
+        }
+        if (parse_event(line, &events[num_events])) {
+            fprintf(stderr, "%s:%d: unable to parse '%s'\n", path, lineno, line);
+            fclose(f);
+            return -1;
+        }
+        num_events++;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void run_event(const struct event* event) {
+    int value = event->value;
+
+    switch (event->type) {
+        case EVENT_INTERACTION:
+            power_hint(POWER_HINT_INTERACTION, &value);
+            break;
+        case EVENT_LAUNCH:
+            power_hint(POWER_HINT_LAUNCH, value ? &value : NULL);
+            break;
+        case EVENT_INTERACTIVE:
+            set_interactive(value);
+            break;
+        case EVENT_SUSTAINED:
+            power_hint(POWER_HINT_SUSTAINED_PERFORMANCE, NULL);
+            break;
+        case EVENT_VIDEO_ENCODE:
+        case EVENT_VIDEO_DECODE:
+            power_hint(event->type == EVENT_VIDEO_ENCODE ? POWER_HINT_VIDEO_ENCODE
+                                                         : POWER_HINT_VIDEO_DECODE,
+                       (void*)event->metadata);
+            break;
+        case EVENT_PROFILE:
+            power_profile(event->profile, value);
+            break;
+        default:
+            break;
+    }
+}
+
+static int compare_ull(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static unsigned long long percentile(const unsigned long long* sorted, size_t n, int pct) {
+    return n ? sorted[(n - 1) * pct / 100] : 0;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [-i iterations] [-s soc_id] [-r] trace...\n"
+            "  -i  replay the traces this many times (default 100)\n"
+            "  -s  soc_id reported by the fake sysfs (default 126, MSM8974)\n"
+            "  -r  honour trace delays instead of replaying back to back\n",
+            argv0);
+}
+
+int main(int argc, char** argv) {
+    char root[] = "/tmp/power-bench.XXXXXX";
+    unsigned long long start, busy_ns = 0, total_ns;
+    int iterations = 100, soc_id = 126, realtime = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:s:r")) != -1) {
+        switch (opt) {
+            case 'i':
+                iterations = atoi(optarg);
+                break;
+            case 's':
+                soc_id = atoi(optarg);
+                break;
+            case 'r':
+                realtime = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind == argc || iterations <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (load_trace(argv[i])) return 1;
+    }
+
+    if (!mkdtemp(root) || make_fake_sysfs(root, soc_id)) {
+        fprintf(stderr, "Unable to create fake sysfs in %s: %s\n", root, strerror(errno));
+        return 1;
+    }
+
+    for (int type = 0; type < NUM_EVENT_TYPES; type++) {
+        latencies[type] = calloc((size_t)num_events * iterations, sizeof(**latencies));
+        if (!latencies[type]) return 1;
+    }
+
+    set_sysfs_root(root);
+    power_init();
+
+    printf("perflock engine: %s\n",
+           dlopen("libqti-perfd-client.so", RTLD_NOW | RTLD_NOLOAD) ? "qcopt" : "native");
+
+    atomic_store(&count_allocs, true);
+    start = now_ns();
+
+    for (int iter = 0; iter < iterations; iter++) {
+        for (int i = 0; i < num_events; i++) {
+            unsigned long long t0, t1;
+
+            if (realtime && events[i].delay_us) usleep(events[i].delay_us);
+
+            t0 = now_ns();
+            run_event(&events[i]);
+            t1 = now_ns();
+
+            busy_ns += t1 - t0;
+            latencies[events[i].type][num_latencies[events[i].type]++] = t1 - t0;
+        }
+    }
+
+    total_ns = now_ns() - start;
+    atomic_store(&count_allocs, false);
+
+    printf("%d events x %d iterations in %.3f ms (%.3f ms in the HAL)\n", num_events, iterations,
+           total_ns / 1e6, busy_ns / 1e6);
+    printf("throughput: %.0f hints/s\n",
+           busy_ns ? (double)num_events * iterations * 1e9 / busy_ns : 0.0);
+    printf("allocations: %llu (%llu bytes), %.2f per hint\n", atomic_load(&num_allocs),
+           atomic_load(&num_alloc_bytes), (double)atomic_load(&num_allocs) / (num_events * iterations));
+
+    printf("%-14s %8s %10s %10s %10s\n", "hint", "count", "p50 us", "p99 us", "max us");
+    for (int type = 0; type < NUM_EVENT_TYPES; type++) {
+        size_t n = num_latencies[type];
+
+        if (!n) continue;
+        qsort(latencies[type], n, sizeof(**latencies), compare_ull);
+        printf("%-14s %8zu %10.2f %10.2f %10.2f\n", event_names[type], n,
+               percentile(latencies[type], n, 50) / 1e3, percentile(latencies[type], n, 99) / 1e3,
+               latencies[type][n - 1] / 1e3);
+    }
+
+    nftw(root, remove_node, 16, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
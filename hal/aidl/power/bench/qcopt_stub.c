@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ * Stand-in for libqti-perfd-client.so on the host. Locks are handed out
+ * and released without touching any resource, so the benchmark measures
+ * the HAL's own overhead on the perfd path.
+ */
+
+#include <stdatomic.h>
+
+static atomic_int next_handle = 1;
+
+int perf_lock_acq(int handle, int duration, int list[], int numArgs) {
+    return handle > 0 ? handle : atomic_fetch_add(&next_handle, 1);
+}
+
+int perf_lock_rel(int handle) {
+    return handle > 0 ? 0 : -1;
+}
+
+int perf_hint(int hint_id, const char* pkg, int duration, int type) {
+    return atomic_fetch_add(&next_handle, 1);
+}
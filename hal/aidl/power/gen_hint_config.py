@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2026 The LineageOS Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Builds the binary hint config read by hint-config.c.
+
+Input is one entry per line, '#' starts a comment:
+
+    <soc_id|*> <key> <value> [<value> ...]
+
+e.g. '* launch_boost 0x704 0x1FE 0x2FE' or '194 display_on' (no values
+disables the hint on that SoC). Values are perflock resource opcodes as
+in performance.h.
+"""
+
+import struct
+import sys
+
+MAGIC = 0x43504848
+VERSION = 1
+MAX_VALUES = 16
+
+# Keep in sync with enum hint_config_key.
+KEYS = [
+    'interaction_boost',
+    'interaction_fling_boost',
+    'launch_boost',
+    'video_encode',
+    'video_decode',
+    'display_off',
+    'display_on',
+    'audio_low_latency',
+    'camera_streaming_low',
+    'camera_streaming_mid',
+    'camera_streaming_high',
+    'expensive_rendering',
+    'vr',
+]
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def parse(lines):
+    entries = []
+    values = []
+    for lineno, line in enumerate(lines, 1):
+        fields = line.split('#', 1)[0].split()
+        if not fields:
+            continue
+        if len(fields) < 2 or fields[1] not in KEYS:
+            sys.exit('line %d: expected <soc_id|*> <key> [values]' % lineno)
+        soc_id = 0 if fields[0] == '*' else int(fields[0], 0)
+        vals = [int(v, 0) for v in fields[2:]]
+        if len(vals) > MAX_VALUES:
+            sys.exit('line %d: more than %d values' % (lineno, MAX_VALUES))
+        entries.append((soc_id, KEYS.index(fields[1]), len(vals), len(values)))
+        values.extend(vals)
+    return entries, values
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: %s <input.txt> <output.bin>' % sys.argv[0])
+
+    with open(sys.argv[1]) as f:
+        entries, values = parse(f)
+
+    body = b''.join(struct.pack('<iHHI', *e) for e in entries)
+    body += struct.pack('<%di' % len(values), *values)
+    header = struct.pack('<IHHII', MAGIC, VERSION, len(entries), len(values), fnv1a(body))
+
+    with open(sys.argv[2], 'wb') as f:
+        f.write(header + body)
+
+
+if __name__ == '__main__':
+    main()
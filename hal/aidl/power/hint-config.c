@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOG_TAG "HH PowerHAL"
+#include <cutils/properties.h>
+#include <log/log.h>
+
+#include "hint-config.h"
+#include "utils.h"
+
+struct hint_config_map {
+    void* base;
+    size_t size;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    struct hint_config_map current;
+    /* Unmapped on the next reload, so lists handed out stay valid meanwhile. */
+    struct hint_config_map retired;
+    struct {
+        int* values;
+        int num_values;
+        int present;
+    } index[NUM_HINT_CONFIG_KEYS];
+} config = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static atomic_int reload_pending;
+
+static uint32_t fnv1a(const uint8_t* data, size_t len) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int validate(const void* base, size_t size) {
+    const struct hint_config_header* header = base;
+    const struct hint_config_entry* entries;
+
+    if (size < sizeof(*header)) return -EINVAL;
+    if (header->magic != HINT_CONFIG_MAGIC || header->version != HINT_CONFIG_VERSION)
+        return -EINVAL;
+    if (size != sizeof(*header) + header->num_entries * sizeof(*entries) +
+                        (size_t)header->num_values * sizeof(int32_t))
+        return -EINVAL;
+    if (fnv1a((const uint8_t*)base + sizeof(*header), size - sizeof(*header)) != header->checksum)
+        return -EINVAL;
+
+    entries = (const struct hint_config_entry*)(header + 1);
+    for (int i = 0; i < header->num_entries; i++) {
+        if (entries[i].key >= NUM_HINT_CONFIG_KEYS ||
+            entries[i].num_values > HINT_CONFIG_MAX_VALUES ||
+            entries[i].offset > header->num_values ||
+            entries[i].num_values > header->num_values - entries[i].offset)
+            return -EINVAL;
+    }
+    return 0;
+}
+
+/* Points the index at the best entry per key for this SoC. Called locked. */
+static void build_index(void) {
+    const struct hint_config_header* header = config.current.base;
+    const struct hint_config_entry* entries;
+    int32_t* values;
+    int soc_id = get_soc_id();
+
+    memset(config.index, 0, sizeof(config.index));
+    if (!header) return;
+
+    entries = (const struct hint_config_entry*)(header + 1);
+    values = (int32_t*)(entries + header->num_entries);
+
+    for (int i = 0; i < header->num_entries; i++) {
+        const struct hint_config_entry* entry = &entries[i];
+
+        if (entry->soc_id != 0 && entry->soc_id != soc_id) continue;
+        /* An exact soc_id match beats a wildcard entry. */
+        if (config.index[entry->key].present && entry->soc_id == 0) continue;
+
+        config.index[entry->key].values = values + entry->offset;
+        config.index[entry->key].num_values = entry->num_values;
+        config.index[entry->key].present = 1;
+    }
+}
+
+static void load(void) {
+    char path[PROPERTY_VALUE_MAX];
+    struct hint_config_map map = {NULL, 0};
+    struct stat st;
+    int fd;
+
+    property_get(HINT_CONFIG_PROP, path, HINT_CONFIG_DEFAULT_PATH);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT) ALOGE("Unable to open hint config %s: %d", path, errno);
+    } else {
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            map.size = st.st_size;
+            map.base = mmap(NULL, map.size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map.base == MAP_FAILED) map.base = NULL;
+        }
+        close(fd);
+
+        if (map.base && validate(map.base, map.size)) {
+            ALOGE("Ignoring invalid hint config %s", path);
+            munmap(map.base, map.size);
+            map.base = NULL;
+        }
+    }
+
+    pthread_mutex_lock(&config.lock);
+    if (config.retired.base) munmap(config.retired.base, config.retired.size);
+    config.retired = config.current;
+    config.current = map;
+    build_index();
+    pthread_mutex_unlock(&config.lock);
+
+    if (map.base) ALOGI("Loaded hint config %s", path);
+}
+
+static void handle_sighup(int sig) {
+    atomic_store(&reload_pending, 1);
+}
+
+void hint_config_init(void) {
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_sighup;
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGHUP, &action, NULL);
+
+    load();
+}
+
+int hint_config_resources(enum hint_config_key key, int* defaults, int num_defaults,
+                          int** resources) {
+    int num = num_defaults;
+
+    if (atomic_exchange(&reload_pending, 0)) load();
+
+    *resources = defaults;
+    if (key < 0 || key >= NUM_HINT_CONFIG_KEYS) return num;
+
+    pthread_mutex_lock(&config.lock);
+    if (config.index[key].present) {
+        *resources = config.index[key].values;
+        num = config.index[key].num_values;
+    }
+    pthread_mutex_unlock(&config.lock);
+
+    return num;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HINT_CONFIG_H__
+#define __HINT_CONFIG_H__
+
+#include <stdint.h>
+
+#include "power-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Optional binary file overriding the compiled-in resource lists, so boosts
+ * can be tuned without rebuilding the HAL. Loaded by power_init() and
+ * reloaded on SIGHUP. The file is mmap'd and used in place:
+ *
+ *   struct hint_config_header
+ *   struct hint_config_entry[num_entries]
+ *   int32_t values[num_values]
+ *
+ * All fields are little-endian. gen_hint_config.py builds it from text.
+ */
+#define HINT_CONFIG_MAGIC 0x43504848 /* "HHPC" */
+#define HINT_CONFIG_VERSION 1
+#define HINT_CONFIG_MAX_VALUES 16
+#define HINT_CONFIG_PROP "persist.vendor.power.hint_config"
+#define HINT_CONFIG_DEFAULT_PATH "/vendor/etc/hint_config.bin"
+
+/* Keep in sync with gen_hint_config.py. */
+enum hint_config_key {
+    CONFIG_INTERACTION_BOOST = 0,
+    CONFIG_INTERACTION_FLING_BOOST,
+    CONFIG_LAUNCH_BOOST,
+    CONFIG_VIDEO_ENCODE,
+    CONFIG_VIDEO_DECODE,
+    CONFIG_DISPLAY_OFF,
+    CONFIG_DISPLAY_ON,
+    /* One key per enum power_profile. */
+    CONFIG_PROFILE_BASE,
+    NUM_HINT_CONFIG_KEYS = CONFIG_PROFILE_BASE + NUM_POWER_PROFILES,
+};
+
+struct hint_config_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_entries;
+    uint32_t num_values;
+    /* FNV-1a over everything after the header. */
+    uint32_t checksum;
+};
+
+struct hint_config_entry {
+    /* soc_id this entry applies to, 0 for any SoC. */
+    int32_t soc_id;
+    uint16_t key;
+    /* 0 disables the hint on matching SoCs. */
+    uint16_t num_values;
+    /* Index of the first value in the values array. */
+    uint32_t offset;
+};
+
+void hint_config_init(void);
+/*
+ * Returns the number of resources to use for 'key' and points 'resources'
+ * at them: the config file's list if it has one for this SoC, otherwise
+ * 'defaults'.
+ */
+int hint_config_resources(enum hint_config_key key, int* defaults, int num_defaults,
+                          int** resources);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HINT_CONFIG_H__
@@ -27,20 +27,132 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
 #include <utils/Log.h>
 
 #include "hint-data.h"
 
-int hint_compare(struct hint_data* first_hint, struct hint_data* other_hint) {
-    if (first_hint == other_hint) {
-        return 0;
-    } else if ((first_hint && other_hint) && (first_hint->hint_id == other_hint->hint_id)) {
-        return 0;
-    } else {
-        return 1;
+/*
+ * Open-addressed, linearly probed table. A slot is bound to a hint_id the
+ * first time that id is added and stays bound while it is inactive, so
+ * there are no tombstones. An inactive slot is only re-keyed once no free
+ * slot is left. Writers serialize on hint_table_lock; readers only use
+ * atomic loads and retry if the slot was re-keyed underneath them.
+ */
+#define HINT_SLOT_EMPTY 0
+
+struct hint_slot {
+    atomic_int hint_id;
+    atomic_int perflock_handle; /* 0 while the hint is not active. */
+};
+
+static struct hint_slot hint_table[HINT_TABLE_SIZE];
+static pthread_mutex_t hint_table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int hint_hash(int hint_id) {
+    /* hint IDs are multiples of 0x100; mix the high bits down. */
+    return ((uint32_t)hint_id * 2654435761u) >> 26;
+}
+
+static struct hint_slot* hint_slot_find(int hint_id) {
+    unsigned int start = hint_hash(hint_id);
+
+    for (unsigned int i = 0; i < HINT_TABLE_SIZE; i++) {
+        struct hint_slot* slot = &hint_table[(start + i) % HINT_TABLE_SIZE];
+        int id = atomic_load(&slot->hint_id);
+
+        if (id == hint_id) return slot;
+        if (id == HINT_SLOT_EMPTY) break;
     }
+
+    return NULL;
 }
 
-void hint_dump(struct hint_data* hint) {
-    ALOGV("hint_id: %lu", hint->hint_id);
+/*
+ * Records 'perflock_handle' as held for 'hint_id'. If the hint was already
+ * active its previous handle is returned in 'prev_handle' (0 otherwise) so
+ * the caller can release it. Returns 0, or -EINVAL / -ENOMEM.
+ */
+int hint_table_add(int hint_id, int perflock_handle, int* prev_handle) {
+    struct hint_slot* slot;
+    int ret = 0;
+
+    *prev_handle = 0;
+    if (hint_id == HINT_SLOT_EMPTY || perflock_handle <= 0) return -EINVAL;
+
+    pthread_mutex_lock(&hint_table_lock);
+
+    slot = hint_slot_find(hint_id);
+    if (!slot) {
+        unsigned int start = hint_hash(hint_id);
+        struct hint_slot* reuse = NULL;
+
+        for (unsigned int i = 0; i < HINT_TABLE_SIZE; i++) {
+            struct hint_slot* s = &hint_table[(start + i) % HINT_TABLE_SIZE];
+
+            if (atomic_load(&s->hint_id) == HINT_SLOT_EMPTY) {
+                slot = s;
+                break;
+            }
+            if (!reuse && atomic_load(&s->perflock_handle) == 0) reuse = s;
+        }
+
+        /*
+         * Re-keying a probe-chain slot is safe: the old id is inactive, and
+         * lookups stop only at empty slots, which are never created here.
+         */
+        if (!slot) slot = reuse;
+        if (slot) atomic_store(&slot->hint_id, hint_id);
+    }
+
+    if (slot)
+        *prev_handle = atomic_exchange(&slot->perflock_handle, perflock_handle);
+    else
+        ret = -ENOMEM;
+
+    pthread_mutex_unlock(&hint_table_lock);
+
+    return ret;
+}
+
+/*
+ * Marks 'hint_id' inactive and returns the perflock handle it held, or 0
+ * if the hint was not active.
+ */
+int hint_table_remove(int hint_id) {
+    struct hint_slot* slot;
+    int handle = 0;
+
+    pthread_mutex_lock(&hint_table_lock);
+    if ((slot = hint_slot_find(hint_id))) handle = atomic_exchange(&slot->perflock_handle, 0);
+    pthread_mutex_unlock(&hint_table_lock);
+
+    return handle;
+}
+
+/*
+ * Lock-free lookup of the perflock handle held for 'hint_id', 0 if none.
+ */
+int hint_table_find(int hint_id) {
+    struct hint_slot* slot;
+    int handle;
+
+    do {
+        if (!(slot = hint_slot_find(hint_id))) return 0;
+        handle = atomic_load(&slot->perflock_handle);
+    } while (atomic_load(&slot->hint_id) != hint_id);
+
+    return handle;
+}
+
+void hint_table_dump(void) {
+    for (unsigned int i = 0; i < HINT_TABLE_SIZE; i++) {
+        int handle = atomic_load(&hint_table[i].perflock_handle);
+
+        if (handle) ALOGV("hint_id: %d, perflock: %d", atomic_load(&hint_table[i].hint_id), handle);
+    }
 }
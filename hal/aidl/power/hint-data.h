@@ -36,6 +36,11 @@
 #define SUSTAINED_PERF_HINT_ID (0x0F00)
 #define VR_MODE_HINT_ID (0x1000)
 #define VR_MODE_SUSTAINED_PERF_HINT_ID (0x1001)
+#define CAM_STREAMING_LOW_HINT_ID (0x0E01)
+#define CAM_STREAMING_MID_HINT_ID (0x0E02)
+#define CAM_STREAMING_HIGH_HINT_ID (0x0E03)
+#define EXPENSIVE_RENDERING_HINT_ID (0x1100)
+#define AUDIO_LOW_LATENCY_HINT_ID (0x1101)
 
 #define AOSP_DELTA (0x1200)
 
@@ -59,10 +64,13 @@ struct hint_handles {
     int ref_count;
 };
 
-struct hint_data {
-    unsigned long hint_id; /* This is our key. */
-    unsigned long perflock_handle;
-};
+/*
+ * Table of perflock handles held by perform_hint_action(), keyed by hint_id.
+ * Slots are preallocated; adding and removing hints never allocates.
+ */
+#define HINT_TABLE_SIZE 64
 
-int hint_compare(struct hint_data* first_hint, struct hint_data* other_hint);
-void hint_dump(struct hint_data* hint);
+int hint_table_add(int hint_id, int perflock_handle, int* prev_handle);
+int hint_table_remove(int hint_id);
+int hint_table_find(int hint_id);
+void hint_table_dump(void);
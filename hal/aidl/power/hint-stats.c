@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "HH PowerHAL"
+#include <log/log.h>
+
+#include "hint-stats.h"
+
+struct hint_latency_stats {
+    /* Hints applied, and hints folded into another one before applying. */
+    atomic_uint_fast64_t applied;
+    atomic_uint_fast64_t coalesced;
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+    /* Bucket i counts latencies below 2^(16 + i) ns; the last one is open. */
+    atomic_uint_fast64_t buckets[HINT_STATS_BUCKETS];
+};
+
+struct hint_residency_stats {
+    atomic_int hint_id;
+    atomic_uint_fast64_t acquired;
+    atomic_uint_fast64_t held_ns;
+    /* CLOCK_MONOTONIC time the hint was acquired at, 0 while released. */
+    atomic_uint_fast64_t since_ns;
+};
+
+struct hint_transition_stats {
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+    atomic_uint_fast64_t writes;
+};
+
+struct hint_stats_page {
+    uint32_t magic;
+    uint32_t version;
+    struct hint_latency_stats latency[NUM_HINT_STATS];
+    struct hint_residency_stats residency[HINT_STATS_RESIDENCY_SLOTS];
+    /* Display off, display on. */
+    struct hint_transition_stats transition[2];
+};
+
+#define HINT_STATS_BUCKET_SHIFT 16 /* ~65us */
+#define HINT_STATS_ATTACH_INTERVAL_NS (10 * 1000000000ULL)
+
+_Static_assert(sizeof(struct hint_stats_page) <= 4096, "hint stats must fit in a page");
+
+static const char* const kind_names[NUM_HINT_STATS] = {
+        [STAT_INTERACTION] = "interaction",
+        [STAT_LAUNCH] = "launch",
+        [STAT_INTERACTIVE] = "interactive",
+        [STAT_SUSTAINED_PERFORMANCE] = "sustained_performance",
+        [STAT_PROFILE_BASE + PROFILE_AUDIO_LOW_LATENCY] = "audio_low_latency",
+        [STAT_PROFILE_BASE + PROFILE_CAMERA_STREAMING_LOW] = "camera_streaming_low",
+        [STAT_PROFILE_BASE + PROFILE_CAMERA_STREAMING_MID] = "camera_streaming_mid",
+        [STAT_PROFILE_BASE + PROFILE_CAMERA_STREAMING_HIGH] = "camera_streaming_high",
+        [STAT_PROFILE_BASE + PROFILE_EXPENSIVE_RENDERING] = "expensive_rendering",
+        [STAT_PROFILE_BASE + PROFILE_VR] = "vr",
+};
+
+/* Counters start out in .bss and move to the shared page once it can be created. */
+static struct hint_stats_page local_page = {.magic = HINT_STATS_MAGIC,
+                                               .version = HINT_STATS_VERSION};
+static _Atomic(struct hint_stats_page*) page = &local_page;
+static atomic_uint_fast64_t next_attach_ns;
+
+uint64_t hint_stats_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void copy_counter(atomic_uint_fast64_t* dst, atomic_uint_fast64_t* src) {
+    atomic_store_explicit(dst, atomic_load_explicit(src, memory_order_relaxed),
+                          memory_order_relaxed);
+}
+
+/*
+ * Moves the counters into a MAP_SHARED page backed by HINT_STATS_PATH.
+ * /data is not mounted when the HAL starts, so this is retried from the
+ * hot paths at most every HINT_STATS_ATTACH_INTERVAL_NS. Updates racing
+ * with the copy may be lost; that is acceptable for statistics.
+ */
+static void try_attach(uint64_t now) {
+    struct hint_stats_page* shared;
+    uint64_t next = atomic_load_explicit(&next_attach_ns, memory_order_relaxed);
+    int fd;
+
+    if (atomic_load_explicit(&page, memory_order_relaxed) != &local_page || now < next) return;
+    if (!atomic_compare_exchange_strong(&next_attach_ns, &next,
+                                        now + HINT_STATS_ATTACH_INTERVAL_NS))
+        return;
+
+    fd = open(HINT_STATS_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+    if (fd < 0) return;
+
+    if (ftruncate(fd, 4096) < 0) {
+        ALOGE("Unable to size %s: %d", HINT_STATS_PATH, errno);
+        close(fd);
+        return;
+    }
+
+    shared = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) return;
+
+    memset(shared, 0, sizeof(*shared));
+    for (int i = 0; i < NUM_HINT_STATS; i++) {
+        struct hint_latency_stats* src = &local_page.latency[i];
+        struct hint_latency_stats* dst = &shared->latency[i];
+
+        copy_counter(&dst->applied, &src->applied);
+        copy_counter(&dst->coalesced, &src->coalesced);
+        copy_counter(&dst->total_ns, &src->total_ns);
+        copy_counter(&dst->max_ns, &src->max_ns);
+        for (int b = 0; b < HINT_STATS_BUCKETS; b++)
+            copy_counter(&dst->buckets[b], &src->buckets[b]);
+    }
+    for (int i = 0; i < HINT_STATS_RESIDENCY_SLOTS; i++) {
+        struct hint_residency_stats* src = &local_page.residency[i];
+        struct hint_residency_stats* dst = &shared->residency[i];
+
+        atomic_store(&dst->hint_id, atomic_load(&src->hint_id));
+        copy_counter(&dst->acquired, &src->acquired);
+        copy_counter(&dst->held_ns, &src->held_ns);
+        copy_counter(&dst->since_ns, &src->since_ns);
+    }
+    for (int i = 0; i < 2; i++) {
+        struct hint_transition_stats* src = &local_page.transition[i];
+        struct hint_transition_stats* dst = &shared->transition[i];
+
+        copy_counter(&dst->count, &src->count);
+        copy_counter(&dst->total_ns, &src->total_ns);
+        copy_counter(&dst->max_ns, &src->max_ns);
+        copy_counter(&dst->writes, &src->writes);
+    }
+    shared->magic = HINT_STATS_MAGIC;
+    shared->version = HINT_STATS_VERSION;
+
+    atomic_store_explicit(&page, shared, memory_order_release);
+}
+
+static struct hint_stats_page* stats_page(uint64_t now) {
+    try_attach(now);
+    return atomic_load_explicit(&page, memory_order_acquire);
+}
+
+static void update_max(atomic_uint_fast64_t* max_ns, uint64_t value) {
+    uint64_t max = atomic_load_explicit(max_ns, memory_order_relaxed);
+
+    while (value > max && !atomic_compare_exchange_weak_explicit(max_ns, &max, value,
+                                                                 memory_order_relaxed,
+                                                                 memory_order_relaxed))
+        ;
+}
+
+void hint_stats_applied(enum hint_stat_kind kind, uint64_t posted_ns) {
+    uint64_t now = hint_stats_now_ns();
+    uint64_t latency = now > posted_ns ? now - posted_ns : 0;
+    struct hint_latency_stats* stats;
+    int bucket = 0;
+
+    if (kind < 0 || kind >= NUM_HINT_STATS) return;
+    stats = &stats_page(now)->latency[kind];
+
+    while (bucket < HINT_STATS_BUCKETS - 1 &&
+           latency >= (1ULL << (HINT_STATS_BUCKET_SHIFT + bucket)))
+        bucket++;
+
+    atomic_fetch_add_explicit(&stats->applied, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->total_ns, latency, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->buckets[bucket], 1, memory_order_relaxed);
+    update_max(&stats->max_ns, latency);
+}
+
+void hint_stats_transition(int on, uint64_t ns, int writes) {
+    struct hint_transition_stats* stats = &stats_page(hint_stats_now_ns())->transition[!!on];
+
+    atomic_fetch_add_explicit(&stats->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->total_ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->writes, writes, memory_order_relaxed);
+    update_max(&stats->max_ns, ns);
+}
+
+void hint_stats_coalesced(enum hint_stat_kind kind) {
+    if (kind < 0 || kind >= NUM_HINT_STATS) return;
+
+    atomic_fetch_add_explicit(&stats_page(hint_stats_now_ns())->latency[kind].coalesced, 1,
+                              memory_order_relaxed);
+}
+
+/* Slots are claimed once per hint_id and never freed; there are few distinct ids. */
+static struct hint_residency_stats* residency_slot(struct hint_stats_page* stats, int hint_id) {
+    for (int i = 0; i < HINT_STATS_RESIDENCY_SLOTS; i++) {
+        struct hint_residency_stats* slot = &stats->residency[i];
+        int id = atomic_load(&slot->hint_id);
+
+        if (id == hint_id) return slot;
+        if (id == 0 && atomic_compare_exchange_strong(&slot->hint_id, &id, hint_id)) return slot;
+        /* Lost the race for an empty slot; it may have been claimed for this id. */
+        if (id == hint_id) return slot;
+    }
+    return NULL;
+}
+
+void hint_stats_hold(int hint_id) {
+    uint64_t now = hint_stats_now_ns();
+    struct hint_residency_stats* slot = residency_slot(stats_page(now), hint_id);
+    uint64_t since = 0;
+
+    if (!slot) return;
+
+    atomic_fetch_add_explicit(&slot->acquired, 1, memory_order_relaxed);
+    /* A repeated hint keeps its original start time. */
+    atomic_compare_exchange_strong(&slot->since_ns, &since, now);
+}
+
+void hint_stats_release(int hint_id) {
+    uint64_t now = hint_stats_now_ns();
+    struct hint_residency_stats* slot = residency_slot(stats_page(now), hint_id);
+    uint64_t since;
+
+    if (!slot) return;
+
+    since = atomic_exchange(&slot->since_ns, 0);
+    if (since && now > since)
+        atomic_fetch_add_explicit(&slot->held_ns, now - since, memory_order_relaxed);
+}
+
+void hint_stats_dump(int fd) {
+    uint64_t now = hint_stats_now_ns();
+    struct hint_stats_page* stats = stats_page(now);
+
+    dprintf(fd, "Hint latency (binder to perflock applied):\n");
+    for (int i = 0; i < NUM_HINT_STATS; i++) {
+        struct hint_latency_stats* s = &stats->latency[i];
+        uint64_t applied = atomic_load(&s->applied);
+
+        if (!applied && !atomic_load(&s->coalesced)) continue;
+
+        dprintf(fd, "  %-22s applied %llu coalesced %llu avg %lluus max %lluus\n", kind_names[i],
+                (unsigned long long)applied, (unsigned long long)atomic_load(&s->coalesced),
+                (unsigned long long)(applied ? atomic_load(&s->total_ns) / applied / 1000 : 0),
+                (unsigned long long)(atomic_load(&s->max_ns) / 1000));
+        dprintf(fd, "    <us:");
+        for (int b = 0; b < HINT_STATS_BUCKETS; b++) {
+            uint64_t count = atomic_load(&s->buckets[b]);
+
+            if (!count) continue;
+            if (b == HINT_STATS_BUCKETS - 1)
+                dprintf(fd, " inf=%llu", (unsigned long long)count);
+            else
+                dprintf(fd, " %llu=%llu", (1ULL << (HINT_STATS_BUCKET_SHIFT + b)) / 1000,
+                        (unsigned long long)count);
+        }
+        dprintf(fd, "\n");
+    }
+
+    dprintf(fd, "Display transitions:\n");
+    for (int i = 0; i < 2; i++) {
+        struct hint_transition_stats* s = &stats->transition[i];
+        uint64_t count = atomic_load(&s->count);
+
+        if (!count) continue;
+        dprintf(fd, "  %-3s count %llu avg %lluus max %lluus writes/commit %.1f\n",
+                i ? "on" : "off", (unsigned long long)count,
+                (unsigned long long)(atomic_load(&s->total_ns) / count / 1000),
+                (unsigned long long)(atomic_load(&s->max_ns) / 1000),
+                (double)atomic_load(&s->writes) / count);
+    }
+
+    dprintf(fd, "Hint residency:\n");
+    for (int i = 0; i < HINT_STATS_RESIDENCY_SLOTS; i++) {
+        struct hint_residency_stats* s = &stats->residency[i];
+        int hint_id = atomic_load(&s->hint_id);
+        uint64_t since = atomic_load(&s->since_ns);
+        uint64_t held = atomic_load(&s->held_ns);
+
+        if (!hint_id) break;
+        if (since && now > since) held += now - since;
+
+        dprintf(fd, "  0x%04x acquired %llu held %llums%s\n", hint_id,
+                (unsigned long long)atomic_load(&s->acquired), (unsigned long long)(held / 1000000),
+                since ? " (active)" : "");
+    }
+    dprintf(fd, "Shared stats page: %s\n", stats == &local_page ? "not attached" : HINT_STATS_PATH);
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __HINT_STATS_H__
+#define __HINT_STATS_H__
+
+#include <stdint.h>
+
+#include "power-common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hint counters live in one page that is also mapped from
+ * HINT_STATS_PATH once /data is available, so tools can read them
+ * without going through binder. The layout is struct hint_stats_page in
+ * hint-stats.c, tagged with HINT_STATS_MAGIC and HINT_STATS_VERSION.
+ * Writers only use relaxed atomic adds.
+ */
+#define HINT_STATS_MAGIC 0x53504848 /* "HHPS" */
+#define HINT_STATS_VERSION 2
+#define HINT_STATS_PATH "/data/vendor/power/hint_stats"
+#define HINT_STATS_BUCKETS 16
+#define HINT_STATS_RESIDENCY_SLOTS 32
+
+enum hint_stat_kind {
+    STAT_INTERACTION = 0,
+    STAT_LAUNCH,
+    STAT_INTERACTIVE,
+    STAT_SUSTAINED_PERFORMANCE,
+    /* One kind per enum power_profile. */
+    STAT_PROFILE_BASE,
+    NUM_HINT_STATS = STAT_PROFILE_BASE + NUM_POWER_PROFILES,
+};
+
+uint64_t hint_stats_now_ns(void);
+/* 'posted_ns' is when the hint entered the HAL, from hint_stats_now_ns(). */
+void hint_stats_applied(enum hint_stat_kind kind, uint64_t posted_ns);
+void hint_stats_coalesced(enum hint_stat_kind kind);
+void hint_stats_hold(int hint_id);
+void hint_stats_release(int hint_id);
+/* A display on/off transition that took 'ns' and made 'writes' sysfs writes. */
+void hint_stats_transition(int on, uint64_t ns, int writes);
+void hint_stats_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __HINT_STATS_H__
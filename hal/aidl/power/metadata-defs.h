@@ -27,14 +27,30 @@
  *
  */
 
+#include <stddef.h>
+
 #define ATTRIBUTE_VALUE_DELIM ('=')
-#define ATTRIBUTE_STRING_DELIM (";")
+#define ATTRIBUTE_STRING_DELIM (';')
 
-#define METADATA_PARSING_ERR (-1)
-#define METADATA_PARSING_CONTINUE (0)
-#define METADATA_PARSING_DONE (1)
+/*
+ * Attribute keys the parser knows about. Each gets a slot in the perfect
+ * hash table in metadata-parser.c; adding a key that collides with an
+ * existing one fails to compile.
+ */
+enum metadata_key {
+    METADATA_KEY_UNKNOWN = -1,
+    METADATA_KEY_HINT_ID = 0,
+    METADATA_KEY_STATE,
+    NUM_METADATA_KEYS,
+};
 
-#define MIN(x, y) (((x) > (y)) ? (y) : (x))
+/* One "key=value" attribute, pointing into the caller's string. */
+struct metadata_token {
+    const char* key;
+    size_t key_len;
+    const char* value;
+    size_t value_len;
+};
 
 struct video_encode_metadata_t {
     int hint_id;
@@ -46,9 +62,10 @@ struct video_decode_metadata_t {
     int state;
 };
 
-int parse_metadata(char* metadata, char** metadata_saveptr, char* attribute,
-                   unsigned int attribute_size, char* value, unsigned int value_size);
-int parse_video_encode_metadata(char* metadata,
+int metadata_next_token(const char** cursor, struct metadata_token* token);
+enum metadata_key metadata_lookup_key(const char* key, size_t len);
+int parse_metadata_ints(const char* metadata, int values[NUM_METADATA_KEYS]);
+int parse_video_encode_metadata(const char* metadata,
                                 struct video_encode_metadata_t* video_encode_metadata);
-int parse_video_decode_metadata(char* metadata,
+int parse_video_decode_metadata(const char* metadata,
                                 struct video_decode_metadata_t* video_decode_metadata);
@@ -27,92 +27,141 @@
  *
  */
 
-#include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "metadata-defs.h"
 
-int parse_metadata(char* metadata, char** metadata_saveptr, char* attribute,
-                   unsigned int attribute_size, char* value, unsigned int value_size) {
-    char* attribute_string;
-    char* attribute_value_delim;
-    unsigned int bytes_to_copy;
-
-    attribute_string = strtok_r(metadata, ATTRIBUTE_STRING_DELIM, metadata_saveptr);
+/*
+ * Perfect hash over the known keys, computed at compile time from the key
+ * length and its first and last characters (spelled out, as C does not
+ * treat a string literal's characters as constants). Keys with identical
+ * hashes would initialize the same table slot, which -Werror rejects.
+ */
+#define METADATA_KEY_TABLE_SIZE 8
+#define METADATA_KEY_HASH(len, first, last) \
+    ((((len)*31u) ^ (unsigned char)(first) ^ ((unsigned char)(last) << 1)) & \
+     (METADATA_KEY_TABLE_SIZE - 1))
+#define METADATA_KEY_ENTRY(str, first, last, id) \
+    [METADATA_KEY_HASH(sizeof(str) - 1, first, last)] = {str, sizeof(str) - 1, id}
+
+_Static_assert((METADATA_KEY_TABLE_SIZE & (METADATA_KEY_TABLE_SIZE - 1)) == 0,
+               "metadata key table size must be a power of two");
+
+static const struct {
+    const char* name;
+    size_t len;
+    enum metadata_key id;
+} metadata_keys[METADATA_KEY_TABLE_SIZE] = {
+        METADATA_KEY_ENTRY("hint_id", 'h', 'd', METADATA_KEY_HINT_ID),
+        METADATA_KEY_ENTRY("state", 's', 'e', METADATA_KEY_STATE),
+};
+
+/*
+ * Returns the next "key=value" attribute after *cursor and advances it, or
+ * 0 at the end of the string. Attributes without a '=' are skipped. The
+ * input is never modified.
+ */
+int metadata_next_token(const char** cursor, struct metadata_token* token) {
+    const char* p = *cursor;
 
-    if (attribute_string == NULL) return METADATA_PARSING_DONE;
+    while (*p) {
+        const char* start = p;
+        const char* delim = NULL;
 
-    attribute[0] = value[0] = '\0';
+        for (; *p && *p != ATTRIBUTE_STRING_DELIM; p++) {
+            if (!delim && *p == ATTRIBUTE_VALUE_DELIM) delim = p;
+        }
 
-    if ((attribute_value_delim = strchr(attribute_string, ATTRIBUTE_VALUE_DELIM)) != NULL) {
-        unsigned int attribute_len = (unsigned int)(attribute_value_delim - attribute_string);
-        /* copy only attribute len + NUL character, or as much as can be fit */
-        bytes_to_copy = MIN(attribute_len + 1, attribute_size);
+        if (delim) {
+            token->key = start;
+            token->key_len = delim - start;
+            token->value = delim + 1;
+            token->value_len = p - (delim + 1);
+        }
 
-        strlcpy(attribute, attribute_string, bytes_to_copy);
-        strlcpy(value, attribute_value_delim + 1, value_size);
+        if (*p) p++;
+        if (delim) {
+            *cursor = p;
+            return 1;
+        }
     }
 
-    return METADATA_PARSING_CONTINUE;
+    *cursor = p;
+    return 0;
 }
 
-int parse_video_encode_metadata(char* metadata,
-                                struct video_encode_metadata_t* video_encode_metadata) {
-    char attribute[1024], value[1024], *saveptr;
-    char* temp_metadata = metadata;
-    int parsing_status;
-
-    while ((parsing_status = parse_metadata(temp_metadata, &saveptr, attribute, sizeof(attribute),
-                                            value, sizeof(value))) == METADATA_PARSING_CONTINUE) {
-        if (strlen(attribute) == strlen("hint_id") &&
-            (strncmp(attribute, "hint_id", strlen("hint_id")) == 0)) {
-            if (strlen(value) > 0) {
-                video_encode_metadata->hint_id = atoi(value);
-            }
-        }
+enum metadata_key metadata_lookup_key(const char* key, size_t len) {
+    unsigned int slot;
 
-        if (strlen(attribute) == strlen("state") &&
-            (strncmp(attribute, "state", strlen("state")) == 0)) {
-            if (strlen(value) > 0) {
-                video_encode_metadata->state = atoi(value);
-            }
-        }
+    if (!len) return METADATA_KEY_UNKNOWN;
 
-        temp_metadata = NULL;
-    }
+    slot = METADATA_KEY_HASH(len, key[0], key[len - 1]);
+    if (metadata_keys[slot].len != len || memcmp(metadata_keys[slot].name, key, len))
+        return METADATA_KEY_UNKNOWN;
+
+    return metadata_keys[slot].id;
+}
+
+/* atoi() on a string view; returns -1 if it does not start with a number. */
+static int parse_int(const char* s, size_t len, int* out) {
+    size_t i = 0;
+    int negative = 0;
+    long value = 0;
 
-    if (parsing_status == METADATA_PARSING_ERR) return -1;
+    if (i < len && (s[i] == '-' || s[i] == '+')) negative = s[i++] == '-';
+    if (i == len || s[i] < '0' || s[i] > '9') return -1;
+
+    for (; i < len && s[i] >= '0' && s[i] <= '9'; i++) {
+        if (value < 0x7FFFFFFF) value = value * 10 + (s[i] - '0');
+    }
+    if (value > 0x7FFFFFFF) value = 0x7FFFFFFF;
 
+    *out = negative ? -(int)value : (int)value;
     return 0;
 }
 
-int parse_video_decode_metadata(char* metadata,
-                                struct video_decode_metadata_t* video_decode_metadata) {
-    char attribute[1024], value[1024], *saveptr;
-    char* temp_metadata = metadata;
-    int parsing_status;
-
-    while ((parsing_status = parse_metadata(temp_metadata, &saveptr, attribute, sizeof(attribute),
-                                            value, sizeof(value))) == METADATA_PARSING_CONTINUE) {
-        if (strlen(attribute) == strlen("hint_id") &&
-            (strncmp(attribute, "hint_id", strlen("hint_id")) == 0)) {
-            if (strlen(value) > 0) {
-                video_decode_metadata->hint_id = atoi(value);
-            }
-        }
+/*
+ * Single pass over 'metadata', storing the integer value of every known
+ * key into 'values'. Keys that are absent or not numeric are left as is.
+ */
+int parse_metadata_ints(const char* metadata, int values[NUM_METADATA_KEYS]) {
+    struct metadata_token token;
 
-        if (strlen(attribute) == strlen("state") &&
-            (strncmp(attribute, "state", strlen("state")) == 0)) {
-            if (strlen(value) > 0) {
-                video_decode_metadata->state = atoi(value);
-            }
-        }
+    if (!metadata) return -1;
 
-        temp_metadata = NULL;
+    while (metadata_next_token(&metadata, &token)) {
+        enum metadata_key key = metadata_lookup_key(token.key, token.key_len);
+
+        if (key != METADATA_KEY_UNKNOWN) parse_int(token.value, token.value_len, &values[key]);
     }
 
-    if (parsing_status == METADATA_PARSING_ERR) return -1;
+    return 0;
+}
+
+int parse_video_encode_metadata(const char* metadata,
+                                struct video_encode_metadata_t* video_encode_metadata) {
+    int values[NUM_METADATA_KEYS] = {
+            [METADATA_KEY_HINT_ID] = video_encode_metadata->hint_id,
+            [METADATA_KEY_STATE] = video_encode_metadata->state,
+    };
+
+    if (parse_metadata_ints(metadata, values)) return -1;
+
+    video_encode_metadata->hint_id = values[METADATA_KEY_HINT_ID];
+    video_encode_metadata->state = values[METADATA_KEY_STATE];
+    return 0;
+}
+
+int parse_video_decode_metadata(const char* metadata,
+                                struct video_decode_metadata_t* video_decode_metadata) {
+    int values[NUM_METADATA_KEYS] = {
+            [METADATA_KEY_HINT_ID] = video_decode_metadata->hint_id,
+            [METADATA_KEY_STATE] = video_decode_metadata->state,
+    };
+
+    if (parse_metadata_ints(metadata, values)) return -1;
 
+    video_decode_metadata->hint_id = values[METADATA_KEY_HINT_ID];
+    video_decode_metadata->state = values[METADATA_KEY_STATE];
     return 0;
 }
@@ -0,0 +1,396 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "HH PowerHAL"
+#include <log/log.h>
+
+#include "perflock.h"
+#include "power-common.h"
+#include "timer-wheel.h"
+#include "utils.h"
+
+#define PERFLOCK_MAX_LOCKS 32
+#define PERFLOCK_MAX_ARGS 16
+#define PERFLOCK_NUM_CPUS 4
+
+/* Legacy opcodes are 0xRRVV: resource in the upper bits, level in the low byte. */
+#define OPCODE_RESOURCE(op) (((unsigned int)(op)) >> 8)
+#define OPCODE_LEVEL(op) ((op)&0xFF)
+
+#define LEVEL_FREQ_MAX 0xFE
+#define LEVEL_CPUS_ALL 0xFF
+
+enum resource_policy {
+    /* The highest requested value wins, e.g. frequency floors. */
+    POLICY_HIGHER,
+    /* The lowest requested value wins, e.g. caps and timer rates. */
+    POLICY_LOWER,
+    /* The most recently acquired lock wins. */
+    POLICY_LATEST,
+};
+
+enum resource_unit {
+    UNIT_RAW,
+    /* Level is in 100 MHz steps, LEVEL_FREQ_MAX is cpuinfo_max_freq. */
+    UNIT_FREQ,
+    /* Level encodes (0xFF - level) * 10 ms, written in us. */
+    UNIT_TIMER_US,
+    /* Number of cpus to keep online. */
+    UNIT_CPUS,
+};
+
+struct resource {
+    unsigned int opcode;
+    const char* node;
+    int cpu;
+    enum resource_policy policy;
+    enum resource_unit unit;
+};
+
+/*
+ * Applied in table order, so cores are onlined before their frequency
+ * floors are written.
+ */
+// clang-format off
+static const struct resource resources[] = {
+    {0x07, "devices/system/cpu/cpu%d/online", 0, POLICY_HIGHER, UNIT_CPUS},
+    {0x02, "devices/system/cpu/cpu0/cpufreq/scaling_min_freq", 0, POLICY_HIGHER, UNIT_FREQ},
+    {0x03, "devices/system/cpu/cpu1/cpufreq/scaling_min_freq", 1, POLICY_HIGHER, UNIT_FREQ},
+    {0x04, "devices/system/cpu/cpu2/cpufreq/scaling_min_freq", 2, POLICY_HIGHER, UNIT_FREQ},
+    {0x05, "devices/system/cpu/cpu3/cpufreq/scaling_min_freq", 3, POLICY_HIGHER, UNIT_FREQ},
+    {0x15, "devices/system/cpu/cpu0/cpufreq/scaling_max_freq", 0, POLICY_LOWER, UNIT_FREQ},
+    {0x16, "devices/system/cpu/cpu1/cpufreq/scaling_max_freq", 1, POLICY_LOWER, UNIT_FREQ},
+    {0x17, "devices/system/cpu/cpu2/cpufreq/scaling_max_freq", 2, POLICY_LOWER, UNIT_FREQ},
+    {0x18, "devices/system/cpu/cpu3/cpufreq/scaling_max_freq", 3, POLICY_LOWER, UNIT_FREQ},
+    {0x0E, "devices/system/cpu/cpufreq/interactive/timer_rate", 0, POLICY_LOWER, UNIT_TIMER_US},
+    {0x0F, "devices/system/cpu/cpufreq/interactive/hispeed_freq", 0, POLICY_HIGHER, UNIT_FREQ},
+    {0x10, "devices/system/cpu/cpufreq/interactive/go_hispeed_load", 0, POLICY_LATEST, UNIT_RAW},
+    {0x1B, "devices/system/cpu/cpufreq/interactive/io_is_busy", 0, POLICY_LATEST, UNIT_RAW},
+    {0x14, "module/cpu_boost/parameters/sync_threshold", 0, POLICY_LATEST, UNIT_FREQ},
+};
+// clang-format on
+
+struct resource_state {
+    char default_value[32];
+    int has_default;
+    long applied;
+    int is_applied;
+};
+
+struct perflock {
+    int handle; /* 0 if the slot is free. */
+    unsigned long seq;
+    struct wheel_timer timer; /* Pending while a timed lock is held. */
+    int timer_handle;         /* Handle the timer was armed for, 0 if none. */
+    int num_args;
+    int opcodes[PERFLOCK_MAX_ARGS];
+};
+
+static struct {
+    pthread_mutex_t lock;
+    int timers_initialized;
+    /* While > 0, resource updates are deferred to perflock_batch_commit(). */
+    int batch_depth;
+    int batch_dirty;
+    int next_handle;
+    unsigned long next_seq;
+    char root[PATH_MAX];
+    long max_freq[PERFLOCK_NUM_CPUS];
+    struct perflock locks[PERFLOCK_MAX_LOCKS];
+    struct resource_state state[ARRAY_SIZE(resources)];
+} engine = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .next_handle = 1,
+        .root = "/sys",
+};
+
+void perflock_set_sysfs_root(const char* root) {
+    pthread_mutex_lock(&engine.lock);
+    strlcpy(engine.root, root, sizeof(engine.root));
+    memset(engine.max_freq, 0, sizeof(engine.max_freq));
+    memset(engine.state, 0, sizeof(engine.state));
+    pthread_mutex_unlock(&engine.lock);
+}
+
+static void node_path(char* path, size_t size, const char* node, int cpu) {
+    char rel[PATH_MAX];
+
+    snprintf(rel, sizeof(rel), node, cpu);
+    snprintf(path, size, "%s/%s", engine.root, rel);
+}
+
+static const struct resource* find_resource(int opcode, size_t* index) {
+    for (size_t i = 0; i < ARRAY_SIZE(resources); i++) {
+        if (resources[i].opcode == OPCODE_RESOURCE(opcode)) {
+            *index = i;
+            return &resources[i];
+        }
+    }
+    return NULL;
+}
+
+static long cpu_max_freq(int cpu) {
+    char path[PATH_MAX], buf[32];
+
+    if (!engine.max_freq[cpu]) {
+        node_path(path, sizeof(path), "devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        if (sysfs_read(path, buf, sizeof(buf)) == 0) engine.max_freq[cpu] = strtol(buf, NULL, 10);
+    }
+    return engine.max_freq[cpu];
+}
+
+/* Returns the value to write for 'opcode', or -1 if it can't be applied. */
+static long decode_level(const struct resource* res, int opcode) {
+    int level = OPCODE_LEVEL(opcode);
+
+    switch (res->unit) {
+        case UNIT_FREQ:
+            if (level >= LEVEL_FREQ_MAX) {
+                long max_freq = cpu_max_freq(res->cpu);
+
+                return max_freq > 0 ? max_freq : -1;
+            }
+            return level * 100000L;
+        case UNIT_TIMER_US:
+            return (0xFF - level) * 10000L;
+        case UNIT_CPUS:
+            if (level == LEVEL_CPUS_ALL) return PERFLOCK_NUM_CPUS;
+            return level <= PERFLOCK_NUM_CPUS ? level : -1;
+        case UNIT_RAW:
+        default:
+            return level;
+    }
+}
+
+/* Returns the number of sysfs writes made. */
+static int apply_resource(size_t index, const struct resource* res, long value) {
+    struct resource_state* state = &engine.state[index];
+    char path[PATH_MAX], buf[32];
+    int writes = 0;
+
+    if (res->unit == UNIT_CPUS) {
+        /* Hotplug is owned by mpdecision; only ever bring cores up. */
+        for (int cpu = 1; cpu < value; cpu++) {
+            node_path(path, sizeof(path), res->node, cpu);
+            sysfs_write(path, "1");
+            writes++;
+        }
+        state->applied = value;
+        state->is_applied = 1;
+        return writes;
+    }
+
+    node_path(path, sizeof(path), res->node, res->cpu);
+
+    if (!state->has_default) {
+        if (sysfs_read(path, state->default_value, sizeof(state->default_value)) != 0) return 0;
+        state->has_default = 1;
+    }
+
+    snprintf(buf, sizeof(buf), "%ld", value);
+    if (sysfs_write(path, buf) == 0) {
+        state->applied = value;
+        state->is_applied = 1;
+    }
+    return 1;
+}
+
+static int restore_resource(size_t index, const struct resource* res) {
+    struct resource_state* state = &engine.state[index];
+    char path[PATH_MAX];
+
+    state->is_applied = 0;
+    if (res->unit == UNIT_CPUS || !state->has_default) return 0;
+    /* The last boost may have asked for exactly the default. */
+    if (state->applied == strtol(state->default_value, NULL, 10)) return 0;
+
+    node_path(path, sizeof(path), res->node, res->cpu);
+    sysfs_write(path, state->default_value);
+    return 1;
+}
+
+/*
+ * Re-evaluates every resource against the active locks and writes only
+ * the ones whose winning value changed. Called locked; returns the number
+ * of sysfs writes made.
+ */
+static int update_resources(void) {
+    int writes = 0;
+
+    if (engine.batch_depth) {
+        engine.batch_dirty = 1;
+        return 0;
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(resources); i++) {
+        const struct resource* res = &resources[i];
+        unsigned long best_seq = 0;
+        long best = -1;
+
+        for (int l = 0; l < PERFLOCK_MAX_LOCKS; l++) {
+            struct perflock* lock = &engine.locks[l];
+
+            if (!lock->handle) continue;
+            for (int a = 0; a < lock->num_args; a++) {
+                long value;
+
+                if (OPCODE_RESOURCE(lock->opcodes[a]) != res->opcode) continue;
+                if ((value = decode_level(res, lock->opcodes[a])) < 0) continue;
+
+                if (best < 0 || (res->policy == POLICY_HIGHER && value > best) ||
+                    (res->policy == POLICY_LOWER && value < best) ||
+                    (res->policy == POLICY_LATEST && lock->seq > best_seq)) {
+                    best = value;
+                    best_seq = lock->seq;
+                }
+            }
+        }
+
+        if (best >= 0) {
+            if (!engine.state[i].is_applied || engine.state[i].applied != best)
+                writes += apply_resource(i, res, best);
+        } else if (engine.state[i].is_applied) {
+            writes += restore_resource(i, res);
+        }
+    }
+    return writes;
+}
+
+static void perflock_expire(void* arg) {
+    struct perflock* lock = arg;
+
+    pthread_mutex_lock(&engine.lock);
+    /*
+     * Skip if the lock was released, renewed after the timer fired, or
+     * the slot was reused, possibly untimed, while this expiry waited for
+     * the lock.
+     */
+    if (lock->handle && lock->handle == lock->timer_handle &&
+        !wheel_timer_pending(&lock->timer)) {
+        lock->handle = 0;
+        lock->timer_handle = 0;
+        update_resources();
+    }
+    pthread_mutex_unlock(&engine.lock);
+}
+
+int perflock_acquire(int handle, int duration, int list[], int num_args) {
+    struct perflock* lock = NULL;
+
+    if (duration < 0 || num_args < 1 || num_args > PERFLOCK_MAX_ARGS) return -1;
+
+    pthread_mutex_lock(&engine.lock);
+
+    if (!engine.timers_initialized) {
+        for (int l = 0; l < PERFLOCK_MAX_LOCKS; l++)
+            wheel_timer_init(&engine.locks[l].timer, perflock_expire, &engine.locks[l]);
+        engine.timers_initialized = 1;
+    }
+
+    /* Re-acquiring a live handle replaces its resources and renews it. */
+    for (int l = 0; handle > 0 && l < PERFLOCK_MAX_LOCKS; l++) {
+        if (engine.locks[l].handle == handle) lock = &engine.locks[l];
+    }
+    for (int l = 0; !lock && l < PERFLOCK_MAX_LOCKS; l++) {
+        if (!engine.locks[l].handle) {
+            lock = &engine.locks[l];
+            lock->handle = engine.next_handle;
+            engine.next_handle = engine.next_handle == INT_MAX ? 1 : engine.next_handle + 1;
+        }
+    }
+
+    if (!lock) {
+        pthread_mutex_unlock(&engine.lock);
+        ALOGE("No free perflock slots");
+        return -1;
+    }
+
+    for (int a = 0; a < num_args; a++) {
+        size_t index;
+
+        if (!find_resource(list[a], &index)) ALOGV("Unsupported perflock opcode 0x%X", list[a]);
+    }
+
+    lock->seq = ++engine.next_seq;
+    lock->num_args = num_args;
+    memcpy(lock->opcodes, list, num_args * sizeof(int));
+
+    if (duration) {
+        wheel_timer_arm(&lock->timer, duration);
+        lock->timer_handle = lock->handle;
+    } else {
+        wheel_timer_cancel(&lock->timer);
+        lock->timer_handle = 0;
+    }
+
+    update_resources();
+    handle = lock->handle;
+
+    pthread_mutex_unlock(&engine.lock);
+
+    return handle;
+}
+
+int perflock_release(int handle) {
+    int ret = -1;
+
+    if (handle <= 0) return -1;
+
+    pthread_mutex_lock(&engine.lock);
+    for (int l = 0; l < PERFLOCK_MAX_LOCKS; l++) {
+        if (engine.locks[l].handle == handle) {
+            engine.locks[l].handle = 0;
+            engine.locks[l].timer_handle = 0;
+            wheel_timer_cancel(&engine.locks[l].timer);
+            update_resources();
+            ret = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&engine.lock);
+
+    return ret;
+}
+
+void perflock_batch_begin(void) {
+    pthread_mutex_lock(&engine.lock);
+    engine.batch_depth++;
+    pthread_mutex_unlock(&engine.lock);
+}
+
+int perflock_batch_commit(void) {
+    int writes = 0;
+
+    pthread_mutex_lock(&engine.lock);
+    if (engine.batch_depth > 0 && --engine.batch_depth == 0 && engine.batch_dirty) {
+        engine.batch_dirty = 0;
+        writes = update_resources();
+    }
+    pthread_mutex_unlock(&engine.lock);
+
+    return writes;
+}
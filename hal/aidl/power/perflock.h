@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __PERFLOCK_H__
+#define __PERFLOCK_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Built-in replacement for the vendor perf library's perf_lock_acq and
+ * perf_lock_rel. Understands the legacy MPCTL opcodes from performance.h
+ * and applies them directly to cpufreq and interactive governor sysfs.
+ */
+int perflock_acquire(int handle, int duration, int list[], int num_args);
+int perflock_release(int handle);
+
+/*
+ * Defers resource writes from acquire/release until the outermost commit,
+ * which writes the net result once, in resource order. Batches nest.
+ * perflock_batch_commit() returns the number of sysfs writes it made.
+ */
+void perflock_batch_begin(void);
+int perflock_batch_commit(void);
+
+/* Prefix for every sysfs node the engine touches, "/sys" by default. */
+void perflock_set_sysfs_root(const char* root);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __PERFLOCK_H__
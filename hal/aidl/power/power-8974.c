@@ -42,6 +42,7 @@
 #include <hardware/power.h>
 #include <log/log.h>
 
+#include "hint-config.h"
 #include "hint-data.h"
 #include "metadata-defs.h"
 #include "performance.h"
@@ -65,6 +66,21 @@ static bool is_target_8974pro(void) {
     return is_8974pro;
 }
 
+/**
+ * Applies the configured resources for 'key' under 'hint_id'. Returns false
+ * if the list is empty, i.e. the hint is disabled on this SoC.
+ */
+static bool perform_config_hint_action(int hint_id, enum hint_config_key key, int* defaults,
+                                       int num_defaults) {
+    int* resources;
+    int num_resources = hint_config_resources(key, defaults, num_defaults, &resources);
+
+    if (num_resources <= 0) return false;
+
+    perform_hint_action(hint_id, resources, num_resources);
+    return true;
+}
+
 static int process_video_encode_hint(void* metadata) {
     char governor[80];
     struct video_encode_metadata_t video_encode_metadata;
@@ -81,7 +97,7 @@ static int process_video_encode_hint(void* metadata) {
     video_encode_metadata.state = -1;
     video_encode_metadata.hint_id = DEFAULT_VIDEO_ENCODE_HINT_ID;
 
-    if (parse_video_encode_metadata((char*)metadata, &video_encode_metadata) == -1) {
+    if (parse_video_encode_metadata((const char*)metadata, &video_encode_metadata) == -1) {
         ALOGE("Error occurred while parsing metadata.");
         return HINT_NONE;
     }
@@ -90,8 +106,8 @@ static int process_video_encode_hint(void* metadata) {
         if (is_interactive_governor(governor)) {
             int resource_values[] = {TR_MS_30, HISPEED_LOAD_90, HS_FREQ_1026,
                                      THREAD_MIGRATION_SYNC_OFF, INTERACTIVE_IO_BUSY_OFF};
-            perform_hint_action(video_encode_metadata.hint_id, resource_values,
-                                ARRAY_SIZE(resource_values));
+            perform_config_hint_action(video_encode_metadata.hint_id, CONFIG_VIDEO_ENCODE,
+                                       resource_values, ARRAY_SIZE(resource_values));
             return HINT_HANDLED;
         }
     } else if (video_encode_metadata.state == 0) {
@@ -119,7 +135,7 @@ static int process_video_decode_hint(void* metadata) {
     video_decode_metadata.state = -1;
     video_decode_metadata.hint_id = DEFAULT_VIDEO_DECODE_HINT_ID;
 
-    if (parse_video_decode_metadata((char*)metadata, &video_decode_metadata) == -1) {
+    if (parse_video_decode_metadata((const char*)metadata, &video_decode_metadata) == -1) {
         ALOGE("Error occurred while parsing metadata.");
         return HINT_NONE;
     }
@@ -128,8 +144,8 @@ static int process_video_decode_hint(void* metadata) {
         if (is_interactive_governor(governor)) {
             int resource_values[] = {TR_MS_30, HISPEED_LOAD_90, HS_FREQ_1026,
                                      THREAD_MIGRATION_SYNC_OFF};
-            perform_hint_action(video_decode_metadata.hint_id, resource_values,
-                                ARRAY_SIZE(resource_values));
+            perform_config_hint_action(video_decode_metadata.hint_id, CONFIG_VIDEO_DECODE,
+                                       resource_values, ARRAY_SIZE(resource_values));
             return HINT_HANDLED;
         }
     } else if (video_decode_metadata.state == 0) {
@@ -179,6 +195,8 @@ static void process_interaction_hint(void* data) {
     struct timespec cur_boost_timespec;
     long long elapsed_time;
     int duration = kDefaultInteractiveDuration;
+    int* resources;
+    int num_resources;
 
     if (data) {
         int input_duration = *((int*)data);
@@ -201,16 +219,22 @@ static void process_interaction_hint(void* data) {
     s_previous_duration = duration;
 
     if (duration >= kMinFlingDuration) {
-        interaction(duration, ARRAY_SIZE(resources_interaction_fling_boost),
-                    resources_interaction_fling_boost);
+        num_resources = hint_config_resources(CONFIG_INTERACTION_FLING_BOOST,
+                                              resources_interaction_fling_boost,
+                                              ARRAY_SIZE(resources_interaction_fling_boost),
+                                              &resources);
     } else {
-        interaction(duration, ARRAY_SIZE(resources_interaction_boost), resources_interaction_boost);
+        num_resources = hint_config_resources(CONFIG_INTERACTION_BOOST, resources_interaction_boost,
+                                              ARRAY_SIZE(resources_interaction_boost), &resources);
     }
+    if (num_resources > 0) interaction(duration, num_resources, resources);
 }
 
 static int process_activity_launch_hint(void* data) {
     static int launch_handle = -1;
     static int launch_mode = 0;
+    int* resources;
+    int num_resources;
 
     // release lock early if launch has finished
     if (!data) {
@@ -223,8 +247,12 @@ static int process_activity_launch_hint(void* data) {
     }
 
     if (!launch_mode) {
-        launch_handle = interaction_with_handle(launch_handle, kMaxLaunchDuration,
-                                                ARRAY_SIZE(resources_launch), resources_launch);
+        num_resources = hint_config_resources(CONFIG_LAUNCH_BOOST, resources_launch,
+                                              ARRAY_SIZE(resources_launch), &resources);
+        if (num_resources <= 0) return HINT_NONE;
+
+        launch_handle = interaction_with_handle(launch_handle, kMaxLaunchDuration, num_resources,
+                                                resources);
         if (!CHECK_HANDLE(launch_handle)) {
             ALOGE("Failed to perform launch boost");
             return HINT_NONE;
@@ -234,6 +262,99 @@ static int process_activity_launch_hint(void* data) {
     return HINT_HANDLED;
 }
 
+// clang-format off
+static int resources_audio_low_latency[] = {
+    CPUS_ONLINE_MIN_2,
+    0x208, /* cpu0 min 800 MHz */
+    TR_MS_20
+};
+
+static int resources_camera_streaming_low[] = {
+    CPUS_ONLINE_MIN_2,
+    TR_MS_30
+};
+
+static int resources_camera_streaming_mid[] = {
+    CPUS_ONLINE_MIN_2,
+    0x208,
+    0x308,
+    TR_MS_30
+};
+
+static int resources_camera_streaming_high[] = {
+    CPUS_ONLINE_MIN_3,
+    CPU0_MIN_FREQ_NONTURBO_MAX,
+    CPU1_MIN_FREQ_NONTURBO_MAX,
+    CPU2_MIN_FREQ_NONTURBO_MAX,
+    TR_MS_20
+};
+
+static int resources_expensive_rendering[] = {
+    CPUS_ONLINE_MIN_3,
+    0x20C, /* cpu0 min 1.2 GHz */
+    0x30C,
+    HS_FREQ_1026,
+    TR_MS_20
+};
+
+static int resources_vr[] = {
+    CPUS_ONLINE_MIN_4,
+    0x20C,
+    0x30C,
+    0x40C,
+    0x50C,
+    TR_MS_20,
+    THREAD_MIGRATION_SYNC_OFF
+};
+// clang-format on
+
+static const struct {
+    int hint_id;
+    int* resources;
+    int num_resources;
+} power_profiles[NUM_POWER_PROFILES] = {
+        [PROFILE_AUDIO_LOW_LATENCY] = {AUDIO_LOW_LATENCY_HINT_ID, resources_audio_low_latency,
+                                       ARRAY_SIZE(resources_audio_low_latency)},
+        [PROFILE_CAMERA_STREAMING_LOW] = {CAM_STREAMING_LOW_HINT_ID, resources_camera_streaming_low,
+                                          ARRAY_SIZE(resources_camera_streaming_low)},
+        [PROFILE_CAMERA_STREAMING_MID] = {CAM_STREAMING_MID_HINT_ID, resources_camera_streaming_mid,
+                                          ARRAY_SIZE(resources_camera_streaming_mid)},
+        [PROFILE_CAMERA_STREAMING_HIGH] = {CAM_STREAMING_HIGH_HINT_ID,
+                                           resources_camera_streaming_high,
+                                           ARRAY_SIZE(resources_camera_streaming_high)},
+        [PROFILE_EXPENSIVE_RENDERING] = {EXPENSIVE_RENDERING_HINT_ID, resources_expensive_rendering,
+                                         ARRAY_SIZE(resources_expensive_rendering)},
+        [PROFILE_VR] = {VR_MODE_HINT_ID, resources_vr, ARRAY_SIZE(resources_vr)},
+};
+
+/*
+ * Each profile holds its own perflock, so overlapping profiles nest: the
+ * perflock owner resolves every resource across all active locks.
+ */
+int power_profile_override(enum power_profile profile, int on) {
+    char governor[80];
+
+    if (!on) {
+        /* Drop the profile even if the governor changed since it was applied. */
+        if (hint_table_find(power_profiles[profile].hint_id))
+            undo_hint_action(power_profiles[profile].hint_id);
+        return HINT_HANDLED;
+    }
+
+    if (get_scaling_governor(governor, sizeof(governor)) == -1) {
+        ALOGE("Can't obtain scaling governor.");
+        return HINT_NONE;
+    }
+
+    if (!is_interactive_governor(governor)) return HINT_NONE;
+
+    if (!perform_config_hint_action(power_profiles[profile].hint_id, CONFIG_PROFILE_BASE + profile,
+                                    power_profiles[profile].resources,
+                                    power_profiles[profile].num_resources))
+        return HINT_NONE;
+    return HINT_HANDLED;
+}
+
 int power_hint_override(power_hint_t hint, void* data) {
     int ret_val = HINT_NONE;
     switch (hint) {
@@ -275,21 +396,20 @@ int set_interactive_override(int on) {
                 undo_initial_hint_action();
                 first_display_off_hint = 1;
             }
-            /* used for all subsequent toggles to the display */
-            undo_hint_action(DISPLAY_STATE_HINT_ID_2);
         }
+        /* used for all subsequent toggles to the display */
+        if (hint_table_find(DISPLAY_STATE_HINT_ID_2)) undo_hint_action(DISPLAY_STATE_HINT_ID_2);
         if (is_interactive_governor(governor)) {
             int resource_values[] = {TR_MS_50, THREAD_MIGRATION_SYNC_OFF};
-            perform_hint_action(DISPLAY_STATE_HINT_ID, resource_values,
-                                ARRAY_SIZE(resource_values));
+            perform_config_hint_action(DISPLAY_STATE_HINT_ID, CONFIG_DISPLAY_OFF, resource_values,
+                                       ARRAY_SIZE(resource_values));
         }
     } else {
         /* Display on */
-        if (is_target_8974pro()) {
-            int resource_values2[] = {CPUS_ONLINE_MIN_2};
-            perform_hint_action(DISPLAY_STATE_HINT_ID_2, resource_values2,
-                                ARRAY_SIZE(resource_values2));
-        }
+        /* Only 8974pro needs this by default; the config may add it elsewhere. */
+        int resource_values2[] = {CPUS_ONLINE_MIN_2};
+        perform_config_hint_action(DISPLAY_STATE_HINT_ID_2, CONFIG_DISPLAY_ON, resource_values2,
+                                   is_target_8974pro() ? ARRAY_SIZE(resource_values2) : 0);
         if (is_interactive_governor(governor)) {
             undo_hint_action(DISPLAY_STATE_HINT_ID);
         }
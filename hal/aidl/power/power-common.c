@@ -43,7 +43,9 @@
 #include <hardware/power.h>
 #include <log/log.h>
 
+#include "hint-config.h"
 #include "hint-data.h"
+#include "hint-stats.h"
 #include "performance.h"
 #include "power-common.h"
 #include "utils.h"
@@ -57,6 +59,8 @@ void power_init() {
         handles[i].handle = 0;
         handles[i].ref_count = 0;
     }
+
+    hint_config_init();
 }
 
 int __attribute__((weak)) power_hint_override(power_hint_t hint, void* data) {
@@ -97,6 +101,17 @@ void power_hint(power_hint_t hint, void* data) {
     }
 }
 
+int __attribute__((weak)) power_profile_override(enum power_profile profile, int on) {
+    return HINT_NONE;
+}
+
+void power_profile(enum power_profile profile, int on) {
+    if (profile < 0 || profile >= NUM_POWER_PROFILES) return;
+
+    if (power_profile_override(profile, on) != HINT_HANDLED)
+        ALOGI("Power profile %d not handled in power_profile_override", profile);
+}
+
 int __attribute__((weak)) set_interactive_override(int on) {
     return HINT_NONE;
 }
@@ -107,6 +122,8 @@ extern void power_set_interactive_ext(int on);
 
 void set_interactive(int on) {
     static int display_hint_sent;
+    uint64_t start;
+    int writes;
 
     if (!on) {
         /* Send Display OFF hint to perf HAL */
@@ -124,13 +141,18 @@ void set_interactive(int on) {
 
     display_hint_sent = !on;
 
+    /* Commit every step's resource changes together, cores first. */
+    start = hint_stats_now_ns();
+    resource_batch_begin();
+
 #ifdef SET_INTERACTIVE_EXT
     power_set_interactive_ext(on);
 #endif
 
-    if (set_interactive_override(on) == HINT_HANDLED) {
-        return;
-    } else {
+    if (set_interactive_override(on) != HINT_HANDLED) {
         ALOGI("Hint not handled in set_interactive_override");
     }
+
+    writes = resource_batch_commit();
+    hint_stats_transition(on, hint_stats_now_ns() - start, writes);
 }
@@ -43,8 +43,20 @@ extern "C" {
 
 enum CPU_GOV_CHECK { CPU0 = 0, CPU1 = 1, CPU2 = 2, CPU3 = 3 };
 
+/* Long-lived modes backed by a resource profile; several may be active. */
+enum power_profile {
+    PROFILE_AUDIO_LOW_LATENCY = 0,
+    PROFILE_CAMERA_STREAMING_LOW,
+    PROFILE_CAMERA_STREAMING_MID,
+    PROFILE_CAMERA_STREAMING_HIGH,
+    PROFILE_EXPENSIVE_RENDERING,
+    PROFILE_VR,
+    NUM_POWER_PROFILES,
+};
+
 void power_init(void);
 void power_hint(power_hint_t hint, void* data);
+void power_profile(enum power_profile profile, int on);
 void set_interactive(int on);
 
 #define ARRAY_SIZE(x) (sizeof((x)) / sizeof((x)[0]))
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#define LOG_NIDEBUG 0
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "HH PowerHAL"
+#include <log/log.h>
+
+#include "timer-wheel.h"
+
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1UL << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+/* Level 1 covers WHEEL_SIZE^2 ticks, about 40 s; longer timers are clamped. */
+#define WHEEL_MAX_TICKS (WHEEL_SIZE * WHEEL_SIZE - 1)
+
+#define NSINMS 1000000L
+
+#define TIMER_IDLE 0
+#define TIMER_PENDING 1
+/* Moved off the wheel by advance(), callback not yet started. */
+#define TIMER_EXPIRING 2
+
+struct wheel_slot {
+    struct wheel_timer head;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_once_t once;
+    int fd;
+    unsigned long now;         /* Last tick processed. */
+    unsigned long programmed;  /* Tick the timerfd is armed for, 0 if disarmed. */
+    uint64_t occupied;         /* Level 0 slots that hold timers. */
+    unsigned int level1_count; /* Timers waiting in level 1. */
+    struct wheel_slot level0[WHEEL_SIZE];
+    struct wheel_slot level1[WHEEL_SIZE];
+} wheel = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .once = PTHREAD_ONCE_INIT,
+        .fd = -1,
+};
+
+static unsigned long current_tick(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * (1000 / WHEEL_TICK_MS) + ts.tv_nsec / (WHEEL_TICK_MS * NSINMS);
+}
+
+static void slot_init(struct wheel_slot* slot) {
+    slot->head.next = slot->head.prev = &slot->head;
+}
+
+static void timer_unlink(struct wheel_timer* timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = timer;
+}
+
+static void slot_add(struct wheel_slot* slot, struct wheel_timer* timer) {
+    timer->next = &slot->head;
+    timer->prev = slot->head.prev;
+    slot->head.prev->next = timer;
+    slot->head.prev = timer;
+}
+
+/* Files 'timer' into the level matching its distance from wheel.now. Called locked. */
+static void timer_enqueue(struct wheel_timer* timer) {
+    if (timer->expires < wheel.now) {
+        /* Already due: run it on the next tick. */
+        timer->expires = wheel.now + 1;
+    }
+
+    if (timer->expires - wheel.now < WHEEL_SIZE) {
+        unsigned long idx = timer->expires & WHEEL_MASK;
+
+        slot_add(&wheel.level0[idx], timer);
+        wheel.occupied |= 1ULL << idx;
+        timer->level = 0;
+    } else {
+        slot_add(&wheel.level1[(timer->expires >> WHEEL_BITS) & WHEEL_MASK], timer);
+        wheel.level1_count++;
+        timer->level = 1;
+    }
+}
+
+static void timer_dequeue(struct wheel_timer* timer) {
+    timer_unlink(timer);
+
+    if (timer->level == 0) {
+        unsigned long idx = timer->expires & WHEEL_MASK;
+
+        if (wheel.level0[idx].head.next == &wheel.level0[idx].head)
+            wheel.occupied &= ~(1ULL << idx);
+    } else {
+        wheel.level1_count--;
+    }
+}
+
+/* First tick after wheel.now that needs servicing, 0 if none. Called locked. */
+static unsigned long next_wakeup(void) {
+    unsigned long next = 0;
+
+    if (wheel.occupied) {
+        unsigned int shift = (wheel.now + 1) & WHEEL_MASK;
+        uint64_t rotated = (wheel.occupied >> shift) | (shift ? wheel.occupied << (64 - shift) : 0);
+
+        next = wheel.now + 1 + __builtin_ctzll(rotated);
+    }
+
+    if (wheel.level1_count) {
+        unsigned long cascade = (wheel.now | WHEEL_MASK) + 1;
+
+        if (!next || cascade < next) next = cascade;
+    }
+
+    return next;
+}
+
+static void program_timerfd(unsigned long tick) {
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = tick / (1000 / WHEEL_TICK_MS);
+    spec.it_value.tv_nsec = (tick % (1000 / WHEEL_TICK_MS)) * WHEEL_TICK_MS * NSINMS;
+
+    if (timerfd_settime(wheel.fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0)
+        ALOGE("Failed to program wheel timerfd: %d", errno);
+    wheel.programmed = tick;
+}
+
+/* Advances the wheel to 'tick', moving due timers onto 'expired'. Called locked. */
+static void advance(unsigned long tick, struct wheel_slot* expired) {
+    while (wheel.now < tick) {
+        struct wheel_slot* slot;
+        unsigned long idx;
+
+        wheel.now++;
+        idx = wheel.now & WHEEL_MASK;
+
+        if (idx == 0) {
+            /* Cascade the level 1 slot that now falls within level 0. */
+            slot = &wheel.level1[(wheel.now >> WHEEL_BITS) & WHEEL_MASK];
+            while (slot->head.next != &slot->head) {
+                struct wheel_timer* timer = slot->head.next;
+
+                timer_unlink(timer);
+                wheel.level1_count--;
+                timer_enqueue(timer);
+            }
+        }
+
+        slot = &wheel.level0[idx];
+        while (slot->head.next != &slot->head) {
+            struct wheel_timer* timer = slot->head.next;
+
+            timer_unlink(timer);
+            timer->state = TIMER_EXPIRING;
+            slot_add(expired, timer);
+        }
+        wheel.occupied &= ~(1ULL << idx);
+    }
+}
+
+static void* wheel_loop(void* arg) {
+    for (;;) {
+        struct wheel_slot expired;
+        unsigned long next;
+        uint64_t ticks;
+
+        if (read(wheel.fd, &ticks, sizeof(ticks)) < 0 && errno != EAGAIN && errno != EINTR) {
+            ALOGE("Timer wheel stopped: %d", errno);
+            break;
+        }
+
+        slot_init(&expired);
+
+        pthread_mutex_lock(&wheel.lock);
+        advance(current_tick(), &expired);
+        next = next_wakeup();
+        if (next)
+            program_timerfd(next);
+        else
+            wheel.programmed = 0;
+        pthread_mutex_unlock(&wheel.lock);
+
+        /*
+         * Timers are popped one at a time under the lock, so a callback that
+         * re-arms or cancels a timer still on 'expired' finds it in a known
+         * state. Owners revalidate with wheel_timer_pending() in case of a
+         * re-arm after the pop.
+         */
+        for (;;) {
+            struct wheel_timer* timer;
+            void (*fn)(void*);
+            void* fn_arg;
+
+            pthread_mutex_lock(&wheel.lock);
+            timer = expired.head.next;
+            if (timer == &expired.head) {
+                pthread_mutex_unlock(&wheel.lock);
+                break;
+            }
+            timer_unlink(timer);
+            timer->state = TIMER_IDLE;
+            fn = timer->fn;
+            fn_arg = timer->arg;
+            pthread_mutex_unlock(&wheel.lock);
+
+            fn(fn_arg);
+        }
+    }
+    return NULL;
+}
+
+static void wheel_start(void) {
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    for (unsigned long i = 0; i < WHEEL_SIZE; i++) {
+        slot_init(&wheel.level0[i]);
+        slot_init(&wheel.level1[i]);
+    }
+    wheel.now = current_tick();
+
+    wheel.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (wheel.fd < 0) {
+        ALOGE("Unable to create wheel timerfd: %d", errno);
+        return;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, wheel_loop, NULL)) ALOGE("Unable to start timer wheel");
+    pthread_attr_destroy(&attr);
+}
+
+void wheel_timer_init(struct wheel_timer* timer, void (*fn)(void*), void* arg) {
+    pthread_once(&wheel.once, wheel_start);
+
+    timer->next = timer->prev = timer;
+    timer->state = TIMER_IDLE;
+    timer->fn = fn;
+    timer->arg = arg;
+}
+
+void wheel_timer_arm(struct wheel_timer* timer, int duration_ms) {
+    unsigned long ticks = (duration_ms + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+    unsigned long now;
+
+    if (ticks > WHEEL_MAX_TICKS) ticks = WHEEL_MAX_TICKS;
+
+    pthread_mutex_lock(&wheel.lock);
+
+    /* Catch up first so a sleeping wheel does not file the timer in a past slot. */
+    now = current_tick();
+    if (wheel.now < now && !wheel.occupied && !wheel.level1_count) wheel.now = now;
+
+    /* A timer still waiting on the expired list is superseded by the re-arm. */
+    if (timer->state == TIMER_PENDING)
+        timer_dequeue(timer);
+    else if (timer->state == TIMER_EXPIRING)
+        timer_unlink(timer);
+    /* 'now' is already partly elapsed; round up so timers never fire early. */
+    timer->expires = now + ticks + 1;
+    timer->state = TIMER_PENDING;
+    timer_enqueue(timer);
+
+    if (wheel.fd >= 0 && (!wheel.programmed || timer->expires < wheel.programmed)) {
+        unsigned long next = next_wakeup();
+
+        if (next && (!wheel.programmed || next < wheel.programmed)) program_timerfd(next);
+    }
+
+    pthread_mutex_unlock(&wheel.lock);
+}
+
+void wheel_timer_cancel(struct wheel_timer* timer) {
+    pthread_mutex_lock(&wheel.lock);
+    if (timer->state == TIMER_PENDING)
+        timer_dequeue(timer);
+    else if (timer->state == TIMER_EXPIRING)
+        timer_unlink(timer);
+    timer->state = TIMER_IDLE;
+    pthread_mutex_unlock(&wheel.lock);
+}
+
+int wheel_timer_pending(struct wheel_timer* timer) {
+    int pending;
+
+    pthread_mutex_lock(&wheel.lock);
+    pending = timer->state == TIMER_PENDING;
+    pthread_mutex_unlock(&wheel.lock);
+
+    return pending;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2026 The LineageOS Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __TIMER_WHEEL_H__
+#define __TIMER_WHEEL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Two-level hashed timer wheel with a 10 ms tick, serviced by a single
+ * timerfd thread. Timers are embedded in their owner, so arming, re-arming
+ * and cancelling are O(1) and never allocate. The timerfd is only
+ * reprogrammed when a timer becomes due before the current wakeup.
+ */
+#define WHEEL_TICK_MS 10
+
+struct wheel_timer {
+    struct wheel_timer* next;
+    struct wheel_timer* prev;
+    unsigned long expires; /* In ticks. */
+    int state;             /* Idle, in the wheel, or waiting to run its callback. */
+    int level;
+    void (*fn)(void* arg);
+    void* arg;
+};
+
+void wheel_timer_init(struct wheel_timer* timer, void (*fn)(void*), void* arg);
+/* (Re-)arms 'timer' to fire 'duration_ms' from now. */
+void wheel_timer_arm(struct wheel_timer* timer, int duration_ms);
+void wheel_timer_cancel(struct wheel_timer* timer);
+int wheel_timer_pending(struct wheel_timer* timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // __TIMER_WHEEL_H__
@@ -31,13 +31,22 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <linux/netlink.h>
+#include <sys/socket.h>
 
 #include "hint-data.h"
-#include "list.h"
+#include "hint-stats.h"
+#include "perflock.h"
+#include "performance.h"
 #include "power-common.h"
+#include "timer-wheel.h"
 #include "utils.h"
 
 #define LOG_TAG "HH PowerHAL"
@@ -46,26 +55,86 @@
 #define USINSEC 1000000L
 #define NSINUS 1000L
 
-#define SOC_ID_0 "/sys/devices/soc0/soc_id"
-#define SOC_ID_1 "/sys/devices/system/soc/soc0/id"
+/* Relative to sysfs_root. */
+#define SOC_ID_0 "devices/soc0/soc_id"
+#define SOC_ID_1 "devices/system/soc/soc0/id"
+#define SCALING_GOV_PATH "devices/system/cpu/cpu%d/cpufreq/scaling_governor"
+#define SCALING_GOV_NUM_CPUS 8
 
-const char* scaling_gov_path[8] = {"/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor",
-                                   "/sys/devices/system/cpu/cpu1/cpufreq/scaling_governor",
-                                   "/sys/devices/system/cpu/cpu2/cpufreq/scaling_governor",
-                                   "/sys/devices/system/cpu/cpu3/cpufreq/scaling_governor",
-                                   "/sys/devices/system/cpu/cpu4/cpufreq/scaling_governor",
-                                   "/sys/devices/system/cpu/cpu5/cpufreq/scaling_governor",
-                                   "/sys/devices/system/cpu/cpu6/cpufreq/scaling_governor",
-                                   "/sys/devices/system/cpu/cpu7/cpufreq/scaling_governor"};
+static char sysfs_root[PATH_MAX] = "/sys";
 
 #define PERF_HAL_PATH "libqti-perfd-client.so"
 static void* qcopt_handle;
 static int (*perf_lock_acq)(int handle, int duration, int list[], int numArgs);
 static int (*perf_lock_rel)(int handle);
 static int (*perf_hint)(int, const char*, int, int);
-static struct list_node active_hint_list_head;
+static int native_perflock;
 const char* pkg = "HH PowerHAL";
 
+/*
+ * Cache of open sysfs file descriptors, keyed by path. Entries are
+ * only ever added, so lookups can probe the table without locking;
+ * each node has its own lock to serialize I/O and stale-fd reopens.
+ */
+#define SYSFS_NODE_CACHE_SIZE 64
+#define SYSFS_NODE_PATH_MAX 128
+
+enum { SYSFS_NODE_FREE = 0, SYSFS_NODE_READY };
+enum { SYSFS_NODE_RD = 0, SYSFS_NODE_WR, SYSFS_NODE_NUM_FDS };
+
+struct sysfs_node {
+    atomic_int state;
+    char path[SYSFS_NODE_PATH_MAX];
+    int fd[SYSFS_NODE_NUM_FDS];
+    pthread_mutex_t lock;
+};
+
+static struct sysfs_node sysfs_nodes[SYSFS_NODE_CACHE_SIZE];
+static pthread_mutex_t sysfs_nodes_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Last scaling governor read from sysfs. It is refreshed when the uevent
+ * watcher bumps governor_generation (CPU hotplug or cpufreq policy change),
+ * and otherwise at most every GOVERNOR_CACHE_MAX_AGE_US, since a governor
+ * switched by writing sysfs directly does not raise a uevent.
+ */
+#define GOVERNOR_CACHE_MAX_AGE_US (1 * USINSEC)
+#define UEVENT_MSG_LEN 1024
+#define UEVENT_CPU_DEVPATH "/devices/system/cpu/"
+
+static struct {
+    pthread_mutex_t lock;
+    char name[80];
+    int valid;
+    unsigned int generation;
+    struct timespec stamp;
+} governor_cache = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static atomic_uint governor_generation;
+static pthread_once_t governor_watcher_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Timed boosts (interaction, fling, launch) are acquired as indefinite
+ * perflocks and released by the timer wheel. A boost renewed with the
+ * same resources only re-arms its timer, without calling into perfd.
+ */
+#define MAX_TIMED_BOOSTS 8
+#define MAX_BOOST_ARGS 16
+
+struct timed_boost {
+    int handle; /* 0 if the slot is free. */
+    int num_args;
+    int args[MAX_BOOST_ARGS];
+    struct wheel_timer timer;
+};
+
+static struct timed_boost timed_boosts[MAX_TIMED_BOOSTS];
+static pthread_mutex_t timed_boosts_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t timed_boosts_once = PTHREAD_ONCE_INIT;
+
+/* An fd whose kobject went away (e.g. cpufreq policy removed on hotplug). */
+#define SYSFS_FD_STALE(err) ((err) == ENODEV || (err) == ENOENT || (err) == EBADF)
+
 static void* get_qcopt_handle() {
     char qcopt_lib_path[PATH_MAX] = {0};
     void* handle = NULL;
@@ -116,79 +185,253 @@ static void __attribute__((constructor)) initialize(void) {
             ALOGE("Unable to get perf_hint function handle.\n");
         }
     }
+
+    if (!perf_lock_acq || !perf_lock_rel) {
+        /* No usable vendor perflocks, apply resources ourselves. */
+        ALOGI("Using native perflock engine.\n");
+        perf_lock_acq = perflock_acquire;
+        perf_lock_rel = perflock_release;
+        native_perflock = 1;
+    }
+}
+
+/* Points the HAL at a different sysfs tree; only meant for host benchmarks. */
+void set_sysfs_root(const char* root) {
+    strlcpy(sysfs_root, root, sizeof(sysfs_root));
+    perflock_set_sysfs_root(root);
+
+    pthread_mutex_lock(&governor_cache.lock);
+    governor_cache.valid = 0;
+    pthread_mutex_unlock(&governor_cache.lock);
+}
+
+static void sysfs_path(char* path, size_t size, const char* node, int cpu) {
+    char rel[PATH_MAX];
+
+    snprintf(rel, sizeof(rel), node, cpu);
+    snprintf(path, size, "%s/%s", sysfs_root, rel);
 }
 
 static void __attribute__((destructor)) cleanup(void) {
     if (qcopt_handle) {
         if (dlclose(qcopt_handle)) ALOGE("Error occurred while closing qc-opt library.");
     }
+
+    for (size_t i = 0; i < ARRAY_SIZE(sysfs_nodes); i++) {
+        if (atomic_load(&sysfs_nodes[i].state) != SYSFS_NODE_READY) continue;
+        for (int dir = 0; dir < SYSFS_NODE_NUM_FDS; dir++) {
+            if (sysfs_nodes[i].fd[dir] >= 0) close(sysfs_nodes[i].fd[dir]);
+        }
+    }
 }
 
-int sysfs_read(const char* path, char* s, int num_bytes) {
-    char buf[80];
-    int count;
-    int ret = 0;
-    int fd = open(path, O_RDONLY);
+/*
+ * Returns the cache node for 'path', inserting it if needed. Returns NULL
+ * if the path is too long or the cache is full; callers then fall back to
+ * an uncached open/close.
+ */
+static struct sysfs_node* sysfs_node_get(const char* path) {
+    size_t len = strlen(path);
+    uint32_t hash = 2166136261u;
 
-    if (fd < 0) {
-        strerror_r(errno, buf, sizeof(buf));
-        ALOGE("Error opening %s: %s\n", path, buf);
+    if (len >= SYSFS_NODE_PATH_MAX) return NULL;
 
-        return -1;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
     }
 
-    if ((count = read(fd, s, num_bytes - 1)) < 0) {
-        strerror_r(errno, buf, sizeof(buf));
-        ALOGE("Error writing to %s: %s\n", path, buf);
+    for (size_t probe = 0; probe < SYSFS_NODE_CACHE_SIZE; probe++) {
+        struct sysfs_node* node = &sysfs_nodes[(hash + probe) & (SYSFS_NODE_CACHE_SIZE - 1)];
+
+        if (atomic_load_explicit(&node->state, memory_order_acquire) == SYSFS_NODE_FREE) {
+            pthread_mutex_lock(&sysfs_nodes_lock);
+            if (atomic_load_explicit(&node->state, memory_order_relaxed) == SYSFS_NODE_FREE) {
+                memcpy(node->path, path, len + 1);
+                node->fd[SYSFS_NODE_RD] = node->fd[SYSFS_NODE_WR] = -1;
+                pthread_mutex_init(&node->lock, NULL);
+                atomic_store_explicit(&node->state, SYSFS_NODE_READY, memory_order_release);
+                pthread_mutex_unlock(&sysfs_nodes_lock);
+                return node;
+            }
+            pthread_mutex_unlock(&sysfs_nodes_lock);
+        }
 
-        ret = -1;
-    } else {
-        s[count] = '\0';
+        if (strcmp(node->path, path) == 0) return node;
     }
 
-    close(fd);
+    return NULL;
+}
+
+/*
+ * pread/pwrite at offset 0 on the cached fd, (re)opening it when it is
+ * missing or has gone stale. Returns the byte count or -1 with errno set.
+ */
+static ssize_t sysfs_node_io(const char* path, int dir, char* s, size_t len) {
+    int flags = (dir == SYSFS_NODE_RD ? O_RDONLY : O_WRONLY) | O_CLOEXEC;
+    struct sysfs_node* node = sysfs_node_get(path);
+    ssize_t ret = -1;
+    int saved_errno;
+
+    if (!node) {
+        int fd = open(path, flags);
+
+        if (fd < 0) return -1;
+        ret = dir == SYSFS_NODE_RD ? read(fd, s, len) : write(fd, s, len);
+        saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return ret;
+    }
+
+    pthread_mutex_lock(&node->lock);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (node->fd[dir] < 0 && (node->fd[dir] = open(node->path, flags)) < 0) break;
+
+        ret = dir == SYSFS_NODE_RD ? pread(node->fd[dir], s, len, 0)
+                                   : pwrite(node->fd[dir], s, len, 0);
+        if (ret >= 0 || !SYSFS_FD_STALE(errno)) break;
+
+        close(node->fd[dir]);
+        node->fd[dir] = -1;
+    }
+    saved_errno = errno;
+    pthread_mutex_unlock(&node->lock);
+    errno = saved_errno;
 
     return ret;
 }
 
-int sysfs_write(const char* path, char* s) {
+int sysfs_read(const char* path, char* s, int num_bytes) {
     char buf[80];
-    int len;
-    int ret = 0;
-    int fd = open(path, O_WRONLY);
+    ssize_t count;
 
-    if (fd < 0) {
+    if ((count = sysfs_node_io(path, SYSFS_NODE_RD, s, num_bytes - 1)) < 0) {
         strerror_r(errno, buf, sizeof(buf));
-        ALOGE("Error opening %s: %s\n", path, buf);
+        ALOGE("Error reading %s: %s\n", path, buf);
+
         return -1;
     }
 
-    len = write(fd, s, strlen(s));
-    if (len < 0) {
+    s[count] = '\0';
+
+    return 0;
+}
+
+int sysfs_write(const char* path, char* s) {
+    char buf[80];
+
+    if (sysfs_node_io(path, SYSFS_NODE_WR, s, strlen(s)) < 0) {
         strerror_r(errno, buf, sizeof(buf));
         ALOGE("Error writing to %s: %s\n", path, buf);
 
-        ret = -1;
+        return -1;
     }
 
-    close(fd);
+    return 0;
+}
 
-    return ret;
+static void* governor_watcher_loop(void* arg) {
+    int sock = (int)(intptr_t)arg;
+    char msg[UEVENT_MSG_LEN];
+    ssize_t n;
+
+    while ((n = recv(sock, msg, sizeof(msg) - 1, 0)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR || errno == ENOBUFS) {
+                /* ENOBUFS means events were dropped; assume one was ours. */
+                atomic_fetch_add(&governor_generation, 1);
+                continue;
+            }
+            strerror_r(errno, msg, sizeof(msg));
+            ALOGE("Governor watcher stopped: %s", msg);
+            break;
+        }
+        msg[n] = '\0';
+
+        /* The first string is "<action>@<devpath>". */
+        char* devpath = strchr(msg, '@');
+        if (devpath && !strncmp(devpath + 1, UEVENT_CPU_DEVPATH, strlen(UEVENT_CPU_DEVPATH)))
+            atomic_fetch_add(&governor_generation, 1);
+    }
+
+    close(sock);
+    return NULL;
+}
+
+static void start_governor_watcher(void) {
+    struct sockaddr_nl addr = {
+            .nl_family = AF_NETLINK,
+            .nl_pid = 0,
+            .nl_groups = 1,
+    };
+    pthread_attr_t attr;
+    pthread_t thread;
+    int sock;
+
+    sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (sock < 0) {
+        ALOGW("Unable to open uevent socket, governor cache is time based only");
+        return;
+    }
+
+    if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ALOGW("Unable to bind uevent socket, governor cache is time based only");
+        close(sock);
+        return;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, governor_watcher_loop, (void*)(intptr_t)sock)) {
+        ALOGW("Unable to start governor watcher");
+        close(sock);
+    }
+    pthread_attr_destroy(&attr);
 }
 
 int get_scaling_governor(char governor[], int size) {
-    for (size_t i = 0; i < ARRAY_SIZE(scaling_gov_path); i++) {
-        if (get_scaling_governor_check_cores(governor, size, i) == 0) {
-            // Obtained the scaling governor. Return.
-            return 0;
+    unsigned int generation;
+    struct timespec now;
+    int ret = 0;
+
+    pthread_once(&governor_watcher_once, start_governor_watcher);
+
+    pthread_mutex_lock(&governor_cache.lock);
+
+    generation = atomic_load(&governor_generation);
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+
+    if (!governor_cache.valid || governor_cache.generation != generation ||
+        calc_timespan_us(governor_cache.stamp, now) >= GOVERNOR_CACHE_MAX_AGE_US) {
+        governor_cache.valid = 0;
+        for (int i = 0; i < SCALING_GOV_NUM_CPUS; i++) {
+            if (get_scaling_governor_check_cores(governor_cache.name, sizeof(governor_cache.name),
+                                                 i) == 0) {
+                // Obtained the scaling governor.
+                governor_cache.valid = 1;
+                governor_cache.generation = generation;
+                governor_cache.stamp = now;
+                break;
+            }
         }
     }
 
-    return -1;
+    if (governor_cache.valid)
+        strlcpy(governor, governor_cache.name, size);
+    else
+        ret = -1;
+
+    pthread_mutex_unlock(&governor_cache.lock);
+
+    return ret;
 }
 
 int get_scaling_governor_check_cores(char governor[], int size, int core_num) {
-    if (sysfs_read(scaling_gov_path[core_num], governor, size) == -1) {
+    char path[PATH_MAX];
+
+    sysfs_path(path, sizeof(path), SCALING_GOV_PATH, core_num);
+    if (sysfs_read(path, governor, size) == -1) {
         // Can't obtain the scaling governor. Return.
         return -1;
     }
@@ -211,17 +454,101 @@ int is_schedutil_governor(char* governor) {
     return 0;
 }
 
+static void timed_boost_expire(void* arg) {
+    struct timed_boost* boost = arg;
+
+    pthread_mutex_lock(&timed_boosts_lock);
+    /* Skip if the boost was released, or renewed after the timer fired. */
+    if (boost->handle && !wheel_timer_pending(&boost->timer)) {
+        perf_lock_rel(boost->handle);
+        boost->handle = 0;
+    }
+    pthread_mutex_unlock(&timed_boosts_lock);
+}
+
+static void timed_boosts_init(void) {
+    for (size_t i = 0; i < ARRAY_SIZE(timed_boosts); i++)
+        wheel_timer_init(&timed_boosts[i].timer, timed_boost_expire, &timed_boosts[i]);
+}
+
+/* Finds the tracked boost holding 'lock_handle'. Called locked. */
+static struct timed_boost* timed_boost_find(int lock_handle) {
+    if (lock_handle <= 0) return NULL;
+
+    for (size_t i = 0; i < ARRAY_SIZE(timed_boosts); i++) {
+        if (timed_boosts[i].handle == lock_handle) return &timed_boosts[i];
+    }
+    return NULL;
+}
+
+static int timed_boost_acquire(int lock_handle, int duration, int num_args, int opt_list[]) {
+    struct timed_boost* boost;
+
+    pthread_once(&timed_boosts_once, timed_boosts_init);
+    pthread_mutex_lock(&timed_boosts_lock);
+
+    boost = timed_boost_find(lock_handle);
+
+    if (duration == 0 || num_args > MAX_BOOST_ARGS) {
+        /* Not something the wheel can own; let the perflock expire itself. */
+        if (boost) {
+            wheel_timer_cancel(&boost->timer);
+            boost->handle = 0;
+        }
+        lock_handle = perf_lock_acq(lock_handle, duration, opt_list, num_args);
+        pthread_mutex_unlock(&timed_boosts_lock);
+        return lock_handle;
+    }
+
+    if (!boost || boost->num_args != num_args ||
+        memcmp(boost->args, opt_list, num_args * sizeof(int))) {
+        struct timed_boost* slot = boost;
+        int handle;
+
+        for (size_t i = 0; !slot && i < ARRAY_SIZE(timed_boosts); i++) {
+            if (!timed_boosts[i].handle) slot = &timed_boosts[i];
+        }
+
+        if (!slot) {
+            /* Out of slots: hand the duration to the perflock instead. */
+            lock_handle = perf_lock_acq(lock_handle, duration, opt_list, num_args);
+            pthread_mutex_unlock(&timed_boosts_lock);
+            return lock_handle;
+        }
+
+        handle = perf_lock_acq(lock_handle, INDEFINITE_DURATION, opt_list, num_args);
+        if (handle == -1) {
+            if (boost) {
+                wheel_timer_cancel(&boost->timer);
+                boost->handle = 0;
+            }
+            pthread_mutex_unlock(&timed_boosts_lock);
+            return -1;
+        }
+
+        boost = slot;
+        boost->handle = handle;
+        boost->num_args = num_args;
+        memcpy(boost->args, opt_list, num_args * sizeof(int));
+    }
+
+    wheel_timer_arm(&boost->timer, duration);
+    lock_handle = boost->handle;
+
+    pthread_mutex_unlock(&timed_boosts_lock);
+
+    return lock_handle;
+}
+
 void interaction(int duration, int num_args, int opt_list[]) {
 #ifdef INTERACTION_BOOST
     static int lock_handle = 0;
 
     if (duration < 0 || num_args < 1 || opt_list[0] == 0) return;
 
-    if (qcopt_handle) {
-        if (perf_lock_acq) {
-            lock_handle = perf_lock_acq(lock_handle, duration, opt_list, num_args);
-            if (lock_handle == -1) ALOGE("Failed to acquire lock.");
-        }
+    if (perf_lock_acq && perf_lock_rel) {
+        lock_handle = timed_boost_acquire(lock_handle, duration, num_args, opt_list);
+        if (lock_handle == -1) ALOGE("Failed to acquire lock.");
     }
 #endif
 }
@@ -229,11 +556,9 @@ void interaction(int duration, int num_args, int opt_list[]) {
 int interaction_with_handle(int lock_handle, int duration, int num_args, int opt_list[]) {
     if (duration < 0 || num_args < 1 || opt_list[0] == 0) return 0;
 
-    if (qcopt_handle) {
-        if (perf_lock_acq) {
-            lock_handle = perf_lock_acq(lock_handle, duration, opt_list, num_args);
-            if (lock_handle == -1) ALOGE("Failed to acquire lock.");
-        }
+    if (perf_lock_acq && perf_lock_rel) {
+        lock_handle = timed_boost_acquire(lock_handle, duration, num_args, opt_list);
+        if (lock_handle == -1) ALOGE("Failed to acquire lock.");
     }
     return lock_handle;
 }
@@ -269,75 +594,58 @@ int perf_hint_enable_with_type(int hint_id, int duration, int type) {
 }
 
 void release_request(int lock_handle) {
-    if (qcopt_handle && perf_lock_rel) perf_lock_rel(lock_handle);
+    struct timed_boost* boost;
+
+    if (!perf_lock_rel) return;
+
+    pthread_mutex_lock(&timed_boosts_lock);
+    if ((boost = timed_boost_find(lock_handle))) {
+        wheel_timer_cancel(&boost->timer);
+        boost->handle = 0;
+    }
+    pthread_mutex_unlock(&timed_boosts_lock);
+
+    perf_lock_rel(lock_handle);
 }
 
 int perform_hint_action(int hint_id, int resource_values[], int num_resources) {
-    if (qcopt_handle && perf_lock_acq) {
+    if (perf_lock_acq && perf_lock_rel) {
         /* Acquire an indefinite lock for the requested resources. */
         int lock_handle = perf_lock_acq(0, 0, resource_values, num_resources);
+        int prev_handle;
+        int ret;
 
         if (lock_handle == -1) {
             ALOGE("Failed to acquire lock.");
             return -EINVAL;
         }
 
-        /* Add this handle to our internal hint-list. */
-        struct hint_data* new_hint = (struct hint_data*)malloc(sizeof(struct hint_data));
-
-        if (!new_hint) {
+        /* Add this handle to our internal hint table. */
+        if ((ret = hint_table_add(hint_id, lock_handle, &prev_handle)) < 0) {
             /* Can't keep track of this lock. Release it. */
-            if (perf_lock_rel) perf_lock_rel(lock_handle);
+            perf_lock_rel(lock_handle);
             ALOGE("Failed to process hint.");
-            return -ENOMEM;
+            return ret;
         }
 
-        if (!active_hint_list_head.compare) {
-            active_hint_list_head.compare = (int (*)(void*, void*))hint_compare;
-            active_hint_list_head.dump = (void (*)(void*))hint_dump;
-        }
-
-        new_hint->hint_id = hint_id;
-        new_hint->perflock_handle = lock_handle;
-
-        if (add_list_node(&active_hint_list_head, new_hint) == NULL) {
-            free(new_hint);
-            /* Can't keep track of this lock. Release it. */
-            if (perf_lock_rel) perf_lock_rel(lock_handle);
-            ALOGE("Failed to process hint.");
-            return -ENOMEM;
-        }
+        /* A repeated hint replaces the lock it held before. */
+        if (prev_handle) perf_lock_rel(prev_handle);
+        hint_stats_hold(hint_id);
     }
     return 0;
 }
 
 void undo_hint_action(int hint_id) {
-    if (qcopt_handle) {
-        if (perf_lock_rel) {
-            /* Get hint-data associated with this hint-id */
-            struct list_node* found_node;
-            struct hint_data temp_hint_data = {.hint_id = hint_id};
-
-            found_node = find_node(&active_hint_list_head, &temp_hint_data);
-
-            if (found_node) {
-                /* Release this lock. */
-                struct hint_data* found_hint_data = (struct hint_data*)(found_node->data);
-
-                if (found_hint_data) {
-                    if (perf_lock_rel(found_hint_data->perflock_handle) == -1)
-                        ALOGE("Perflock release failed.");
-                }
-
-                if (found_node->data) {
-                    /* We can free the hint-data for this node. */
-                    free(found_node->data);
-                }
-
-                remove_list_node(&active_hint_list_head, found_node);
-            } else {
-                ALOGE("Invalid hint ID.");
-            }
+    if (perf_lock_rel) {
+        /* Get the perflock handle associated with this hint-id */
+        int lock_handle = hint_table_remove(hint_id);
+
+        if (lock_handle) {
+            /* Release this lock. */
+            if (perf_lock_rel(lock_handle) == -1) ALOGE("Perflock release failed.");
+            hint_stats_release(hint_id);
+        } else {
+            ALOGE("Invalid hint ID.");
         }
     }
 }
@@ -347,22 +655,36 @@ void undo_hint_action(int hint_id) {
  * two cores online when the display is on
  */
 void undo_initial_hint_action() {
-    if (qcopt_handle) {
+    /* Handle 1 is perfd's boot-time lock; the native engine has none. */
+    if (qcopt_handle && !native_perflock) {
         if (perf_lock_rel) {
             perf_lock_rel(1);
         }
     }
 }
 
+/*
+ * Groups the perflock changes of a multi-step transition so the native
+ * engine writes each resource once. perfd applies locks itself, so this
+ * is a no-op there.
+ */
+void resource_batch_begin(void) {
+    if (native_perflock) perflock_batch_begin();
+}
+
+int resource_batch_commit(void) {
+    return native_perflock ? perflock_batch_commit() : 0;
+}
+
 int get_soc_id(void) {
     int fd;
     int soc_id = -1;
     char buf[10] = {0};
+    char path[PATH_MAX];
 
-    if (!access(SOC_ID_0, F_OK))
-        fd = open(SOC_ID_0, O_RDONLY);
-    else
-        fd = open(SOC_ID_1, O_RDONLY);
+    sysfs_path(path, sizeof(path), SOC_ID_0, 0);
+    if (access(path, F_OK)) sysfs_path(path, sizeof(path), SOC_ID_1, 0);
+    fd = open(path, O_RDONLY);
 
     if (fd >= 0) {
         if (read(fd, buf, sizeof(buf) - 1) == -1)
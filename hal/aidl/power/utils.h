@@ -47,3 +47,6 @@ int perf_hint_enable_with_type(int hint_id, int duration, int type);
 
 long long calc_timespan_us(struct timespec start, struct timespec end);
 int get_soc_id(void);
+void set_sysfs_root(const char* root);
+void resource_batch_begin(void);
+int resource_batch_commit(void);
@@ -2,8 +2,19 @@
 #include <android-base/logging.h>
 
 #include <cutils/properties.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cinttypes>
 #include <cmath>
+#include <functional>
 #include <iostream>
 #include <fstream>
 #include <thread>
@@ -22,26 +33,63 @@ static const char *VIBRATOR_AMPLITUDE_STRONG_PROP = "ro.vibrator.hal.amplitude.s
 static const char *VIBRATOR_EFFECT_CLICK_DURATION_PROP = "ro.vibrator.hal.click.duration";
 static const char *VIBRATOR_EFFECT_TICK_DURATION_PROP = "ro.vibrator.hal.tick.duration";
 
-Vibrator::Vibrator(std::ofstream&& enable) : mEnable(std::move(enable)) {
-    mVtgLevel.open(VIBRATOR_LEVEL_PATH);
+static constexpr int32_t kComposeDelayMaxMs = 1000;
+static constexpr int32_t kComposeSizeMax = 32;
 
-    mVtgDefault = 65;
-    std::ifstream vtgDefault(VIBRATOR_DEFAULT_PATH);
-    if (vtgDefault) {
-        vtgDefault >> mVtgDefault;
-    }
+/*
+ * A segment followed by another powered one is enabled for slightly longer
+ * than its duration, so the kernel timer never stops the motor in the gap
+ * before the next segment re-arms it.
+ */
+static constexpr int32_t kChainSlackMs = 2;
 
-    mVtgMax = 100;
-    std::ifstream vtgMax(VIBRATOR_MAX_PATH);
-    if (vtgMax) {
-        vtgMax >> mVtgMax;
-    }
+/* Pause between the two clicks of DOUBLE_CLICK. */
+static constexpr int32_t kDoubleClickGapMs = 100;
+
+/* SCHED_FIFO priority of the scheduler thread, which also plays compositions. */
+static constexpr int kCompositionPriority = 2;
+
+static int64_t nowNs() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Arms 'timer' for the absolute CLOCK_MONOTONIC time 'deadlineNs', or disarms it for 0. */
+static void armTimer(const unique_fd& timer, int64_t deadlineNs) {
+    struct itimerspec spec = {};
 
-    mVtgMin = 0;
-    std::ifstream vtgMin(VIBRATOR_MIN_PATH);
-    if (vtgMin) {
-        vtgMin >> mVtgMin;
+    if (deadlineNs) {
+        spec.it_value.tv_sec = deadlineNs / 1000000000LL;
+        spec.it_value.tv_nsec = deadlineNs % 1000000000LL;
     }
+    if (timerfd_settime(timer.get(), TFD_TIMER_ABSTIME, &spec, nullptr))
+        LOG(ERROR) << "Failed to arm vibrator timer. Error: " << errno << " - "
+                   << strerror(errno);
+}
+
+/* Parsed as an int: streaming into a uint8_t would read a single character. */
+static uint8_t readVtg(const std::string& path, uint8_t fallback) {
+    std::ifstream file(path);
+    int value;
+
+    if (!(file >> value)) return fallback;
+    return (uint8_t)value;
+}
+
+Vibrator::Vibrator(unique_fd&& enable)
+    : mEnable(std::move(enable)),
+      mVtgLevel(open(VIBRATOR_LEVEL_PATH.c_str(), O_WRONLY | O_CLOEXEC)),
+      mSegment(0),
+      mSegmentDeadlineNs(0),
+      mTimer(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+      mCompletionTimer(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)),
+      mCompletionStats(),
+      mExitEvent(eventfd(0, EFD_CLOEXEC)) {
+    mVtgDefault = readVtg(VIBRATOR_DEFAULT_PATH, 65);
+    mVtgMax = readVtg(VIBRATOR_MAX_PATH, 100);
+    mVtgMin = readVtg(VIBRATOR_MIN_PATH, 0);
 
     mEffectClickDuration = (int32_t)property_get_int32(VIBRATOR_EFFECT_CLICK_DURATION_PROP, 40);
     mEffectTickDuration = (int32_t)property_get_int32(VIBRATOR_EFFECT_TICK_DURATION_PROP, 20);
@@ -49,11 +97,256 @@ Vibrator::Vibrator(std::ofstream&& enable) : mEnable(std::move(enable)) {
     mAmplitudeLight = (uint8_t)property_get_int32(VIBRATOR_AMPLITUDE_LIGTH_PROP, 45);
     mAmplitudeMedium = (uint8_t)property_get_int32(VIBRATOR_AMPLITUDE_MEDIUM_PROP, 65);
     mAmplitudeStrong = (uint8_t)property_get_int32(VIBRATOR_AMPLITUDE_STRONG_PROP, 85);
+
+    mAmplitudeLevel = mVtgDefault;
+    mLevel = 0;
+
+    /* Envelopes are tuned for the ERM motor, which needs ~15 ms to react to a level change. */
+    mPrimitives[(size_t)CompositePrimitive::CLICK] = {{1.0f, mEffectClickDuration}};
+    mPrimitives[(size_t)CompositePrimitive::THUD] = {{1.0f, 40}, {0.6f, 40}, {0.3f, 40}};
+    mPrimitives[(size_t)CompositePrimitive::SPIN] = {{0.5f, 30}, {1.0f, 60}, {0.5f, 30}};
+    mPrimitives[(size_t)CompositePrimitive::QUICK_RISE] =
+            {{0.25f, 15}, {0.5f, 15}, {0.75f, 15}, {1.0f, 15}};
+    mPrimitives[(size_t)CompositePrimitive::SLOW_RISE] =
+            {{0.2f, 40}, {0.4f, 40}, {0.6f, 40}, {0.8f, 40}, {1.0f, 40}};
+    mPrimitives[(size_t)CompositePrimitive::QUICK_FALL] =
+            {{1.0f, 15}, {0.75f, 15}, {0.5f, 15}, {0.25f, 15}};
+    mPrimitives[(size_t)CompositePrimitive::LIGHT_TICK] = {{0.5f, mEffectTickDuration}};
+
+    /*
+     * Effects are rendered for every strength up front, so perform() only
+     * has to pick a waveform. HEAVY_CLICK asks for more than full scale,
+     * which lifts its weaker strengths while STRONG is clamped to vtg_max.
+     */
+    const std::vector<std::pair<Effect, std::vector<PrimitiveStep>>> envelopes = {
+        {Effect::CLICK, mPrimitives[(size_t)CompositePrimitive::CLICK]},
+        {Effect::DOUBLE_CLICK,
+         {{1.0f, mEffectClickDuration}, {0.0f, kDoubleClickGapMs}, {1.0f, mEffectClickDuration}}},
+        {Effect::TICK, {{1.0f, mEffectTickDuration}}},
+        {Effect::THUD, mPrimitives[(size_t)CompositePrimitive::THUD]},
+        {Effect::POP, {{1.0f, 15}}},
+        {Effect::HEAVY_CLICK, {{1.25f, mEffectClickDuration * 3 / 2}}},
+        {Effect::TEXTURE_TICK, {{0.5f, 10}}},
+    };
+    const float strengths[] = {mAmplitudeLight / 100.0f, mAmplitudeMedium / 100.0f,
+                               mAmplitudeStrong / 100.0f};
+
+    for (const auto& [effect, steps] : envelopes) {
+        EffectWaveforms entry = {effect, {}};
+
+        for (size_t i = 0; i < entry.waveforms.size(); i++) {
+            Waveform& waveform = entry.waveforms[i];
+
+            waveform.durationMs = 0;
+            for (const PrimitiveStep& step : steps) {
+                appendSegment(waveform.segments, amplitudeToLevel(step.amplitude * strengths[i]),
+                              step.durationMs);
+                waveform.durationMs += step.durationMs;
+            }
+        }
+        mEffects.push_back(std::move(entry));
+    }
+
+    if (mTimer < 0 || mCompletionTimer < 0 || mExitEvent < 0)
+        LOG(ERROR) << "Failed to create vibrator timers. Error: " << errno << " - "
+                   << strerror(errno);
+    mSchedulerThread = std::thread(&Vibrator::schedulerLoop, this);
+}
+
+Vibrator::~Vibrator() {
+    uint64_t one = 1;
+
+    TEMP_FAILURE_RETRY(write(mExitEvent.get(), &one, sizeof(one)));
+    mSchedulerThread.join();
+}
+
+uint8_t Vibrator::amplitudeToLevel(float amplitude) const {
+    if (amplitude <= 0.0f) return 0;
+
+    amplitude = std::min(amplitude, 1.0f);
+    return (uint8_t)std::lround((amplitude - 0.01f) * (mVtgMax - mVtgMin) + mVtgMin);
+}
+
+bool Vibrator::writeLevelLocked(uint8_t level) {
+    char buf[8];
+    int len;
+
+    if (mVtgLevel < 0 || level == mLevel) return true;
+
+    len = snprintf(buf, sizeof(buf), "%u\n", level);
+    if (TEMP_FAILURE_RETRY(write(mVtgLevel.get(), buf, len)) != len) {
+        LOG(ERROR) << "Failed to set amplitude. Error: " << errno << " - " << strerror(errno);
+        return false;
+    }
+
+    mLevel = level;
+    return true;
+}
+
+bool Vibrator::writeEnableLocked(int32_t timeoutMs) {
+    char buf[16];
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "%d\n", timeoutMs);
+    if (TEMP_FAILURE_RETRY(write(mEnable.get(), buf, len)) != len) {
+        LOG(ERROR) << "Failed to turn vibrator " << (timeoutMs ? "on" : "off")
+                   << ". Error: " << errno << " - " << strerror(errno);
+        return false;
+    }
+
+    return true;
+}
+
+void Vibrator::startSegmentLocked() {
+    const Segment& segment = mTimeline[mSegment];
+
+    if (segment.level) {
+        bool chained = mSegment + 1 < mTimeline.size() && mTimeline[mSegment + 1].level;
+
+        writeLevelLocked(segment.level);
+        writeEnableLocked(segment.durationMs + (chained ? kChainSlackMs : 0));
+    }
+
+    /* Deadlines are absolute, so write latency never accumulates across segments. */
+    mSegmentDeadlineNs += segment.durationMs * 1000000LL;
+    armTimer(mTimer, mSegmentDeadlineNs);
+}
+
+/* Moves to the next segment, queueing the callback once the composition is over. */
+void Vibrator::advanceCompositionLocked() {
+    if (mTimeline.empty()) return;
+
+    if (++mSegment < mTimeline.size()) {
+        startSegmentLocked();
+        return;
+    }
+
+    mTimeline.clear();
+    writeLevelLocked(mAmplitudeLevel);
+    if (mComposeCallback != nullptr) {
+        scheduleCompletionLocked(mSegmentDeadlineNs, mComposeCallback);
+        mComposeCallback.reset();
+    }
+}
+
+/* Replaces whatever is playing with 'timeline', starting its first segment right away. */
+void Vibrator::playTimelineLocked(const std::vector<Segment>& timeline,
+                                  const std::shared_ptr<IVibratorCallback>& callback) {
+    cancelCompositionLocked();
+    cancelCompletionsLocked();
+
+    /* Copy-assignment reuses mTimeline's storage, so replaying an effect does not allocate. */
+    mTimeline = timeline;
+    mSegment = 0;
+    mComposeCallback = callback;
+    mSegmentDeadlineNs = nowNs();
+    startSegmentLocked();
+}
+
+void Vibrator::cancelCompositionLocked() {
+    if (mTimeline.empty()) return;
+
+    mTimeline.clear();
+    mComposeCallback.reset();
+    armTimer(mTimer, 0);
+    writeLevelLocked(mAmplitudeLevel);
+}
+
+void Vibrator::scheduleCompletionLocked(int64_t deadlineNs,
+                                        const std::shared_ptr<IVibratorCallback>& callback) {
+    mCompletions.push_back({deadlineNs, callback});
+    std::push_heap(mCompletions.begin(), mCompletions.end(), std::greater<Completion>());
+
+    mCompletionStats.scheduled++;
+    mCompletionStats.maxDepth = std::max(mCompletionStats.maxDepth, mCompletions.size());
+    if (mCompletions.front().deadlineNs == deadlineNs) armTimer(mCompletionTimer, deadlineNs);
+}
+
+void Vibrator::cancelCompletionsLocked() {
+    if (mCompletions.empty()) return;
+
+    mCompletionStats.cancelled += mCompletions.size();
+    mCompletions.clear();
+    armTimer(mCompletionTimer, 0);
+}
+
+/* Pops every completion due by 'now' into 'due' and re-arms the timer for the rest. */
+void Vibrator::takeDueCompletionsLocked(int64_t now, std::vector<Completion>* due) {
+    while (!mCompletions.empty() && mCompletions.front().deadlineNs <= now) {
+        uint64_t latencyNs = now - mCompletions.front().deadlineNs;
+
+        std::pop_heap(mCompletions.begin(), mCompletions.end(), std::greater<Completion>());
+        due->push_back(std::move(mCompletions.back()));
+        mCompletions.pop_back();
+
+        mCompletionStats.completed++;
+        mCompletionStats.latencyTotalNs += latencyNs;
+        mCompletionStats.latencyMaxNs = std::max(mCompletionStats.latencyMaxNs, latencyNs);
+    }
+
+    if (!due->empty())
+        armTimer(mCompletionTimer, mCompletions.empty() ? 0 : mCompletions.front().deadlineNs);
+}
+
+/*
+ * The HAL's only thread: plays compositions and delivers every completion
+ * callback, sleeping in poll() without a timeout while nothing is pending.
+ */
+void Vibrator::schedulerLoop() {
+    struct sched_param param = {.sched_priority = kCompositionPriority};
+    struct pollfd fds[] = {
+        {mExitEvent.get(), POLLIN, 0},
+        {mTimer.get(), POLLIN, 0},
+        {mCompletionTimer.get(), POLLIN, 0},
+    };
+    std::vector<Completion> due;
+    uint64_t expirations;
+    int ret;
+
+    ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (ret) {
+        LOG(WARNING) << "Failed to make vibrator scheduler real-time. Error: " << ret << " - "
+                     << strerror(ret);
+    }
+
+    while (true) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG(ERROR) << "Vibrator scheduler failed. Error: " << errno << " - " << strerror(errno);
+            return;
+        }
+        if (fds[0].revents) return;
+
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+
+            /* Re-arming a timer clears a stale expiration, so these reads fail after a cancel. */
+            if (fds[1].revents && read(mTimer.get(), &expirations, sizeof(expirations)) > 0)
+                advanceCompositionLocked();
+            if (fds[2].revents)
+                TEMP_FAILURE_RETRY(read(mCompletionTimer.get(), &expirations, sizeof(expirations)));
+            takeDueCompletionsLocked(nowNs(), &due);
+        }
+
+        for (const Completion& completion : due) {
+            int64_t start = nowNs();
+
+            if (!completion.callback->onComplete().isOk()) {
+                LOG(ERROR) << "Failed to call onComplete";
+            }
+
+            std::lock_guard<std::mutex> lock(mLock);
+            mCompletionStats.callbackMaxNs =
+                    std::max<uint64_t>(mCompletionStats.callbackMaxNs, nowNs() - start);
+        }
+        due.clear();
+    }
 }
 
 ndk::ScopedAStatus Vibrator::getCapabilities(int32_t* _aidl_return) {
-    *_aidl_return = IVibrator::CAP_ON_CALLBACK | IVibrator::CAP_PERFORM_CALLBACK;
-    if (mVtgLevel.is_open()) {
+    *_aidl_return = IVibrator::CAP_ON_CALLBACK | IVibrator::CAP_PERFORM_CALLBACK |
+                    IVibrator::CAP_COMPOSE_EFFECTS;
+    if (mVtgLevel >= 0) {
         *_aidl_return |= IVibrator::CAP_AMPLITUDE_CONTROL;
     }
 
@@ -61,9 +354,11 @@ ndk::ScopedAStatus Vibrator::getCapabilities(int32_t* _aidl_return) {
 }
 
 ndk::ScopedAStatus Vibrator::off() {
-    mEnable << 0 << std::endl;
-    if (!mEnable) {
-        LOG(ERROR) << "Failed to turn vibrator off. Error: " << errno << " - " << strerror(errno);
+    std::lock_guard<std::mutex> lock(mLock);
+
+    cancelCompositionLocked();
+    cancelCompletionsLocked();
+    if (!writeEnableLocked(0)) {
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_SERVICE_SPECIFIC));
     }
 
@@ -72,65 +367,49 @@ ndk::ScopedAStatus Vibrator::off() {
 
 ndk::ScopedAStatus Vibrator::on(int32_t timeoutMs,
                                 const std::shared_ptr<IVibratorCallback>& callback) {
-    mEnable << timeoutMs << std::endl;
-    if (!mEnable) {
-        LOG(ERROR) << "Failed to turn vibrator on. Error: " << errno << " - " << strerror(errno);
+    std::lock_guard<std::mutex> lock(mLock);
+
+    /* The new vibration replaces whatever was playing, along with its callbacks. */
+    cancelCompositionLocked();
+    cancelCompletionsLocked();
+    if (!writeEnableLocked(timeoutMs)) {
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_SERVICE_SPECIFIC));
     }
 
     if (callback != nullptr) {
-        std::thread([=] {
-            usleep(timeoutMs * 1000);
-            if (!callback->onComplete().isOk()) {
-                LOG(ERROR) << "Failed to call onComplete";
-            }
-        }).detach();
+        scheduleCompletionLocked(nowNs() + timeoutMs * 1000000LL, callback);
     }
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::perform(Effect effect, EffectStrength es, const std::shared_ptr<IVibratorCallback>& callback, int32_t* _aidl_return) {
-    float amplitude = 1.0f;
-    switch (es) {
-        case EffectStrength::LIGHT:
-            amplitude = (float)(mAmplitudeLight / 100);
-            break;
-        case EffectStrength::MEDIUM:
-            amplitude = (float)(mAmplitudeMedium / 100);
-            break;
-        case EffectStrength::STRONG:
-        default:
-            amplitude = (float)(mAmplitudeStrong / 100);
-            break;
-    }
-
-    ndk::ScopedAStatus status = ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
-    switch (effect) {
-        case Effect::CLICK:
-            setAmplitude(amplitude);
-            *_aidl_return = mEffectClickDuration;
-            status = on(mEffectClickDuration, callback);
-            break;
-        case Effect::TICK:
-            setAmplitude(amplitude);
-            *_aidl_return = mEffectTickDuration;
-            status = on(mEffectTickDuration, callback);
-            break;
-        default:
-            break;
-    }
-
-    return status;
+    size_t strength = std::min((size_t)es, (size_t)EffectStrength::STRONG);
+
+    for (const EffectWaveforms& entry : mEffects) {
+        if (entry.effect != effect) continue;
+
+        const Waveform& waveform = entry.waveforms[strength];
+        std::lock_guard<std::mutex> lock(mLock);
+
+        playTimelineLocked(waveform.segments, callback);
+        *_aidl_return = waveform.durationMs;
+        return ndk::ScopedAStatus::ok();
+    }
+
+    return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
 }
 
 ndk::ScopedAStatus Vibrator::getSupportedEffects(std::vector<Effect>* _aidl_return) {
-    *_aidl_return = {Effect::CLICK, Effect::TICK};
+    _aidl_return->clear();
+    for (const EffectWaveforms& entry : mEffects) {
+        _aidl_return->push_back(entry.effect);
+    }
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::setAmplitude(float amplitude) {
-    if (!mVtgLevel.is_open()) {
+    if (mVtgLevel < 0) {
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
     }
 
@@ -138,10 +417,11 @@ ndk::ScopedAStatus Vibrator::setAmplitude(float amplitude) {
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
     }
 
-    long intensity = std::lround((amplitude - 0.01f) * (mVtgMax - mVtgMin) + mVtgMin);
-    mVtgLevel << intensity << std::endl;
-    if (!mVtgLevel) {
-        LOG(ERROR) << "Failed to set amplitude. Error: " << errno << " - " << strerror(errno);
+    std::lock_guard<std::mutex> lock(mLock);
+
+    /* A running composition drives the level itself and restores this one when done. */
+    mAmplitudeLevel = amplitudeToLevel(amplitude);
+    if (mTimeline.empty() && !writeLevelLocked(mAmplitudeLevel)) {
         return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_SERVICE_SPECIFIC));
     }
     return ndk::ScopedAStatus::ok();
@@ -151,26 +431,79 @@ ndk::ScopedAStatus Vibrator::setExternalControl(bool enabled __unused) {
     return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
 }
 
-ndk::ScopedAStatus Vibrator::getCompositionDelayMax(int32_t* maxDelayMs __unused) {
-    return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+ndk::ScopedAStatus Vibrator::getCompositionDelayMax(int32_t* maxDelayMs) {
+    *maxDelayMs = kComposeDelayMaxMs;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getCompositionSizeMax(int32_t* maxSize __unused) {
-    return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+ndk::ScopedAStatus Vibrator::getCompositionSizeMax(int32_t* maxSize) {
+    *maxSize = kComposeSizeMax;
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getSupportedPrimitives(std::vector<CompositePrimitive>* supported __unused) {
-    return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+ndk::ScopedAStatus Vibrator::getSupportedPrimitives(std::vector<CompositePrimitive>* supported) {
+    supported->clear();
+    for (size_t i = 0; i < mPrimitives.size(); i++) {
+        supported->push_back((CompositePrimitive)i);
+    }
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::getPrimitiveDuration(CompositePrimitive primitive __unused,
-                                                  int32_t* durationMs __unused) {
-    return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+ndk::ScopedAStatus Vibrator::getPrimitiveDuration(CompositePrimitive primitive,
+                                                  int32_t* durationMs) {
+    if ((size_t)primitive >= mPrimitives.size()) {
+        return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+    }
+
+    *durationMs = 0;
+    for (const PrimitiveStep& step : mPrimitives[(size_t)primitive]) {
+        *durationMs += step.durationMs;
+    }
+    return ndk::ScopedAStatus::ok();
 }
 
-ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect>& composite __unused,
-                                     const std::shared_ptr<IVibratorCallback>& callback __unused) {
-    return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+void Vibrator::appendSegment(std::vector<Segment>& timeline, uint8_t level, int32_t durationMs) {
+    if (!timeline.empty() && timeline.back().level == level)
+        timeline.back().durationMs += durationMs;
+    else
+        timeline.push_back({level, durationMs});
+}
+
+ndk::ScopedAStatus Vibrator::compose(const std::vector<CompositeEffect>& composite,
+                                     const std::shared_ptr<IVibratorCallback>& callback) {
+    std::vector<Segment> timeline;
+
+    if (composite.size() > (size_t)kComposeSizeMax) {
+        return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
+    }
+
+    for (const CompositeEffect& effect : composite) {
+        if (effect.delayMs < 0 || effect.delayMs > kComposeDelayMaxMs ||
+            effect.scale < 0.0f || effect.scale > 1.0f) {
+            return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_ILLEGAL_ARGUMENT));
+        }
+        if ((size_t)effect.primitive >= mPrimitives.size()) {
+            return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
+        }
+
+        if (effect.delayMs) appendSegment(timeline, 0, effect.delayMs);
+        for (const PrimitiveStep& step : mPrimitives[(size_t)effect.primitive]) {
+            appendSegment(timeline, amplitudeToLevel(step.amplitude * effect.scale),
+                          step.durationMs);
+        }
+    }
+
+    if (timeline.empty()) {
+        if (callback != nullptr && !callback->onComplete().isOk()) {
+            LOG(ERROR) << "Failed to call onComplete";
+        }
+        return ndk::ScopedAStatus::ok();
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+
+    playTimelineLocked(timeline, callback);
+    return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus Vibrator::getSupportedAlwaysOnEffects(std::vector<Effect>* _aidl_return __unused) {
@@ -186,6 +519,21 @@ ndk::ScopedAStatus Vibrator::alwaysOnDisable(int32_t id __unused) {
     return ndk::ScopedAStatus(AStatus_fromExceptionCode(EX_UNSUPPORTED_OPERATION));
 }
 
+binder_status_t Vibrator::dump(int fd, const char** /* args */, uint32_t /* numArgs */) {
+    std::lock_guard<std::mutex> lock(mLock);
+    const CompletionStats& s = mCompletionStats;
+
+    dprintf(fd, "Completion callbacks:\n");
+    dprintf(fd, "  pending %zu max %zu\n", mCompletions.size(), s.maxDepth);
+    dprintf(fd, "  scheduled %" PRIu64 " completed %" PRIu64 " cancelled %" PRIu64 "\n",
+            s.scheduled, s.completed, s.cancelled);
+    dprintf(fd, "  latency avg %" PRIu64 "us max %" PRIu64 "us, callback max %" PRIu64 "us\n",
+            s.completed ? s.latencyTotalNs / s.completed / 1000 : 0, s.latencyMaxNs / 1000,
+            s.callbackMaxNs / 1000);
+    fsync(fd);
+    return STATUS_OK;
+}
+
 }  // namespace vibrator
 }  // namespace hardware
 }  // namespace android
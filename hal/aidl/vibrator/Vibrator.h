@@ -17,8 +17,11 @@
 #pragma once
 
 #include <aidl/android/hardware/vibrator/BnVibrator.h>
-#include <fstream>
+#include <android-base/unique_fd.h>
+#include <array>
 #include <mutex>
+#include <thread>
+#include <vector>
 
 namespace aidl {
 namespace android {
@@ -31,9 +34,12 @@ const static std::string VIBRATOR_LEVEL_PATH = "/sys/class/timed_output/vibrator
 const static std::string VIBRATOR_MAX_PATH = "/sys/class/timed_output/vibrator/vtg_max";
 const static std::string VIBRATOR_MIN_PATH = "/sys/class/timed_output/vibrator/vtg_min";
 
+using ::android::base::unique_fd;
+
 class Vibrator : public BnVibrator {
 public:
-    Vibrator(std::ofstream&& enable);
+    Vibrator(unique_fd&& enable);
+    ~Vibrator();
 
     ndk::ScopedAStatus getCapabilities(int32_t* _aidl_return) override;
     ndk::ScopedAStatus off() override;
@@ -45,8 +51,8 @@ public:
     ndk::ScopedAStatus getSupportedEffects(std::vector<Effect>* _aidl_return) override;
     ndk::ScopedAStatus setAmplitude(float amplitude) override;
     ndk::ScopedAStatus setExternalControl(bool enabled) override;
-    ndk::ScopedAStatus getCompositionDelayMax(int32_t* maxDelayMs);
-    ndk::ScopedAStatus getCompositionSizeMax(int32_t* maxSize);
+    ndk::ScopedAStatus getCompositionDelayMax(int32_t* maxDelayMs) override;
+    ndk::ScopedAStatus getCompositionSizeMax(int32_t* maxSize) override;
     ndk::ScopedAStatus getSupportedPrimitives(std::vector<CompositePrimitive>* supported) override;
     ndk::ScopedAStatus getPrimitiveDuration(CompositePrimitive primitive,
                                             int32_t* durationMs) override;
@@ -56,9 +62,70 @@ public:
     ndk::ScopedAStatus alwaysOnEnable(int32_t id, Effect effect, EffectStrength strength) override;
     ndk::ScopedAStatus alwaysOnDisable(int32_t id) override;
 
+    binder_status_t dump(int fd, const char** args, uint32_t numArgs) override;
+
 private:
-    std::ofstream mEnable;
-    std::ofstream mVtgLevel;
+    /* One step of a composition: 'level' is a vtg_level value, 0 leaves the motor off. */
+    struct Segment {
+        uint8_t level;
+        int32_t durationMs;
+    };
+
+    /* An onComplete() owed to a client once 'deadlineNs' has passed. */
+    struct Completion {
+        int64_t deadlineNs;
+        std::shared_ptr<IVibratorCallback> callback;
+
+        bool operator>(const Completion& other) const { return deadlineNs > other.deadlineNs; }
+    };
+
+    struct CompletionStats {
+        uint64_t scheduled;
+        uint64_t completed;
+        uint64_t cancelled;
+        size_t maxDepth;
+        uint64_t latencyTotalNs;
+        uint64_t latencyMaxNs;
+        uint64_t callbackMaxNs;
+    };
+
+    /* One step of a primitive's envelope, before scaling. */
+    struct PrimitiveStep {
+        float amplitude;
+        int32_t durationMs;
+    };
+
+    struct Waveform {
+        std::vector<Segment> segments;
+        int32_t durationMs;
+    };
+
+    /* An effect's waveform for each EffectStrength. */
+    struct EffectWaveforms {
+        Effect effect;
+        std::array<Waveform, (size_t)EffectStrength::STRONG + 1> waveforms;
+    };
+
+    static void appendSegment(std::vector<Segment>& timeline, uint8_t level, int32_t durationMs);
+    uint8_t amplitudeToLevel(float amplitude) const;
+    bool writeLevelLocked(uint8_t level);
+    bool writeEnableLocked(int32_t timeoutMs);
+
+    void playTimelineLocked(const std::vector<Segment>& timeline,
+                            const std::shared_ptr<IVibratorCallback>& callback);
+    void startSegmentLocked();
+    void advanceCompositionLocked();
+    void cancelCompositionLocked();
+
+    void scheduleCompletionLocked(int64_t deadlineNs,
+                                  const std::shared_ptr<IVibratorCallback>& callback);
+    void cancelCompletionsLocked();
+    void takeDueCompletionsLocked(int64_t now, std::vector<Completion>* due);
+
+    void schedulerLoop();
+
+    unique_fd mEnable;
+    unique_fd mVtgLevel;
 
     uint8_t mAmplitudeLight;
     uint8_t mAmplitudeMedium;
@@ -70,6 +137,39 @@ private:
     uint8_t mVtgDefault;
     uint8_t mVtgMax;
     uint8_t mVtgMin;
+
+    /* vtg_level last requested through setAmplitude(), restored after a composition. */
+    uint8_t mAmplitudeLevel;
+    /* vtg_level last written to the node. */
+    uint8_t mLevel;
+
+    std::array<std::vector<PrimitiveStep>, (size_t)CompositePrimitive::LIGHT_TICK + 1> mPrimitives;
+    std::vector<EffectWaveforms> mEffects;
+
+    /*
+     * The composition or effect being played. Segments are started from
+     * mSchedulerThread, which runs at real-time priority and sleeps on
+     * mTimer until the next segment's absolute deadline.
+     */
+    std::vector<Segment> mTimeline;
+    size_t mSegment;
+    int64_t mSegmentDeadlineNs;
+    std::shared_ptr<IVibratorCallback> mComposeCallback;
+    unique_fd mTimer;
+
+    /*
+     * Pending completion callbacks, a min-heap on deadline delivered by
+     * mSchedulerThread when mCompletionTimer fires. A new vibration or
+     * off() cancels every callback still pending.
+     */
+    std::vector<Completion> mCompletions;
+    unique_fd mCompletionTimer;
+    CompletionStats mCompletionStats;
+
+    unique_fd mExitEvent;
+
+    std::mutex mLock;
+    std::thread mSchedulerThread;
 };
 
 }  // namespace vibrator
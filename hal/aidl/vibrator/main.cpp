@@ -20,14 +20,17 @@
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 
+#include <fcntl.h>
+
 #include "Vibrator.h"
 
 using aidl::android::hardware::vibrator::Vibrator;
 using aidl::android::hardware::vibrator::VIBRATOR_ENABLE_PATH;
+using ::android::base::unique_fd;
 
 std::shared_ptr<Vibrator> createVibratorService() {
-    std::ofstream enable(VIBRATOR_ENABLE_PATH);
-    if (!enable) {
+    unique_fd enable(open(VIBRATOR_ENABLE_PATH.c_str(), O_WRONLY | O_CLOEXEC));
+    if (enable < 0) {
         LOG(ERROR) << "Failed to open " << VIBRATOR_ENABLE_PATH << ". Error: " << errno << " - " << strerror(errno);
         return NULL;
     }
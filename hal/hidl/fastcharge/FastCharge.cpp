@@ -20,8 +20,15 @@
 #include <android-base/logging.h>
 #include <cutils/properties.h>
 
-#include <fstream>
-#include <iostream>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 #include "hh_fastcharge.h"
 
 namespace vendor {
@@ -30,64 +37,145 @@ namespace fastcharge {
 namespace V1_0 {
 namespace implementation {
 
+#define UEVENT_MSG_LEN 2048
+#define UEVENT_POWER_SUPPLY "SUBSYSTEM=power_supply"
+
 /*
- * Write value to path and close file.
+ * Charger plug and unplug events are when the kernel may flip the switch
+ * on its own, so they trigger a re-read.
  */
-template <typename T>
-static void set(const std::string& path, const T& value) {
-    std::ofstream file(path);
-
-    if (!file) {
-        PLOG(ERROR) << "Failed to open: " << path;
-        return;
+static bool isPowerSupplyUevent(const char* msg, ssize_t len) {
+    for (const char* s = msg; s < msg + len; s += strlen(s) + 1) {
+        if (!strcmp(s, UEVENT_POWER_SUPPLY)) return true;
     }
+    return false;
+}
 
-    LOG(DEBUG) << "write: " << path << " value: " << value;
-
-    file << value << std::endl;
+FastCharge::FastCharge() : mFd(open(FASTCHARGE_PATH, O_RDWR | O_CLOEXEC)), mEnabled(false) {
+    if (mFd < 0) PLOG(ERROR) << "Failed to open: " << FASTCHARGE_PATH;
 
-    if (!file) {
-        PLOG(ERROR) << "Failed to write: " << path << " value: " << value;
+    mPersisted = property_get_bool(FASTCHARGE_PROP, FASTCHARGE_DEFAULT_SETTING);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        readLocked();
+        /* Nothing has been published yet, so force the first publishLocked(). */
+        mPublished = !mEnabled;
     }
+    setEnabled(mPersisted);
+
+    /* The service object lives as long as the process. */
+    std::thread(&FastCharge::watchLoop, this).detach();
 }
 
-template <typename T>
-static T get(const std::string& path, const T& def) {
-    std::ifstream file(path);
+/* Refreshes the cache from sysfs. */
+bool FastCharge::readLocked() {
+    char buf[8];
+    ssize_t len = TEMP_FAILURE_RETRY(pread(mFd.get(), buf, sizeof(buf) - 1, 0));
 
-    if (!file) {
-        PLOG(ERROR) << "Failed to open: " << path;
-        return def;
+    if (len <= 0) {
+        PLOG(ERROR) << "Failed to read: " << FASTCHARGE_PATH;
+        return mEnabled;
     }
+    buf[len] = '\0';
 
-    T result;
+    mEnabled = atoi(buf) != 0;
+    LOG(DEBUG) << "read: " << FASTCHARGE_PATH << " value: " << mEnabled;
+    return mEnabled;
+}
 
-    file >> result;
+/*
+ * The state property doubles as the change notification for clients; only
+ * real changes are set. It is not persistent, so it costs no flash write.
+ */
+void FastCharge::publishLocked() {
+    if (mEnabled == mPublished) return;
 
-    if (file.fail()) {
-        PLOG(ERROR) << "Failed to read: " << path;
-        return def;
-    } else {
-        LOG(DEBUG) << "read: " << path << " value: " << result;
-        return result;
-    }
+    property_set(FASTCHARGE_STATE_PROP, mEnabled ? "true" : "false");
+    mPublished = mEnabled;
 }
 
-FastCharge::FastCharge() {
-    setEnabled(property_get_bool(FASTCHARGE_PROP, FASTCHARGE_DEFAULT_SETTING));
+/*
+ * Picks up changes made outside the HAL after a power_supply uevent, when
+ * the driver may have reset the switch. The node is never sysfs_notify()'d,
+ * so a write from the shell is only seen on the next such uevent.
+ */
+void FastCharge::watchLoop() {
+    struct sockaddr_nl addr = {};
+    unique_fd sock(socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                          NETLINK_KOBJECT_UEVENT));
+    char msg[UEVENT_MSG_LEN];
+
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;
+    if (sock < 0 || bind(sock.get(), (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        PLOG(WARNING) << "Unable to listen for uevents";
+        return;
+    }
+
+    struct pollfd fds[] = {
+            {sock.get(), POLLIN, 0},
+    };
+
+    while (true) {
+        bool recheck = false;
+        ssize_t n;
+
+        if (poll(fds, 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            PLOG(ERROR) << "Fast charge watcher stopped";
+            return;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while ((n = recv(sock.get(), msg, sizeof(msg) - 1, 0)) > 0) {
+                msg[n] = '\0';
+                if (isPowerSupplyUevent(msg, n)) recheck = true;
+            }
+            /* ENOBUFS means events were dropped; assume one was ours. */
+            if (n < 0 && errno == ENOBUFS) recheck = true;
+        }
+        if (!recheck) continue;
+
+        std::lock_guard<std::mutex> lock(mLock);
+        bool enabled = mEnabled;
+
+        if (readLocked() != enabled) {
+            LOG(INFO) << "Fast charge " << (mEnabled ? "enabled" : "disabled")
+                      << " outside the HAL";
+            publishLocked();
+        }
+    }
 }
 
 Return<bool> FastCharge::isEnabled() {
-    return get(FASTCHARGE_PATH, 0) != 0;
+    std::lock_guard<std::mutex> lock(mLock);
+
+    return mEnabled;
 }
 
 Return<bool> FastCharge::setEnabled(bool enable) {
-    set(FASTCHARGE_PATH, enable ? 1 : 0);
+    std::lock_guard<std::mutex> lock(mLock);
 
-    bool enabled = isEnabled();
-    property_set(FASTCHARGE_PROP, enabled ? "true" : "false");
+    if (enable != mEnabled) {
+        const char* value = enable ? "1\n" : "0\n";
+
+        LOG(DEBUG) << "write: " << FASTCHARGE_PATH << " value: " << enable;
+        if (TEMP_FAILURE_RETRY(pwrite(mFd.get(), value, 2, 0)) != 2) {
+            PLOG(ERROR) << "Failed to write: " << FASTCHARGE_PATH << " value: " << enable;
+        }
+
+        /* The driver may refuse the change, so report what it actually holds. */
+        readLocked();
+    }
+    publishLocked();
+
+    /* Only changes made through the HAL are restored on the next boot. */
+    if (mEnabled != mPersisted) {
+        property_set(FASTCHARGE_PROP, mEnabled ? "true" : "false");
+        mPersisted = mEnabled;
+    }
 
-    return enabled;
+    return mEnabled;
 }
 
 }  // namespace implementation
@@ -17,10 +17,13 @@
 #ifndef VENDOR_LINEAGE_FASTCHARGE_V1_0_FASTCHARGE_H
 #define VENDOR_LINEAGE_FASTCHARGE_V1_0_FASTCHARGE_H
 
+#include <android-base/unique_fd.h>
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 #include <vendor/lineage/fastcharge/1.0/IFastCharge.h>
 
+#include <mutex>
+
 namespace vendor {
 namespace lineage {
 namespace fastcharge {
@@ -28,6 +31,7 @@ namespace V1_0 {
 namespace implementation {
 
 using ::android::sp;
+using ::android::base::unique_fd;
 using ::android::hardware::hidl_array;
 using ::android::hardware::hidl_memory;
 using ::android::hardware::hidl_string;
@@ -43,6 +47,22 @@ struct FastCharge : public IFastCharge {
 
     Return<bool> isEnabled() override;
     Return<bool> setEnabled(bool enable) override;
+
+  private:
+    bool readLocked();
+    void publishLocked();
+    void watchLoop();
+
+    /*
+     * The switch node stays open for the life of the service and its value
+     * is cached, so isEnabled() never touches sysfs.
+     */
+    unique_fd mFd;
+    bool mEnabled;
+    /* Last values set on FASTCHARGE_STATE_PROP and FASTCHARGE_PROP. */
+    bool mPublished;
+    bool mPersisted;
+    std::mutex mLock;
 };
 
 }  // namespace implementation
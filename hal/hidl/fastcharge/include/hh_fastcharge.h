@@ -20,5 +20,6 @@
 #define FASTCHARGE_DEFAULT_SETTING false
 #define FASTCHARGE_PATH "/sys/kernel/fast_charge/force_fast_charge"
 #define FASTCHARGE_PROP "persist.vendor.fastcharge.enabled"
+#define FASTCHARGE_STATE_PROP "vendor.fastcharge.state"
 
 #endif // HH_FASTCHARGE_H
@@ -31,12 +31,7 @@
 
 package com.sony.timekeep;
 
-import java.nio.ByteBuffer;
-import java.nio.ByteOrder;
-import java.io.BufferedOutputStream;
 import java.io.File;
-import java.io.FileOutputStream;
-import java.io.FileNotFoundException;
 import java.io.FileInputStream;
 import java.io.IOException;
 import java.lang.Long;
@@ -46,13 +41,15 @@ import android.content.BroadcastReceiver;
 import android.content.Context;
 import android.content.Intent;
 import android.util.Log;
+import android.os.SystemClock;
 import android.os.SystemProperties;
 
 public class TimeKeep extends BroadcastReceiver {
 	private static final String TAG = "TimeKeep-Receiver";
 	private static final String TIMEADJ_PROP = "persist.vendor.timeadjust";
+	// Any new value makes init run "timekeep store", see timekeep.rc
+	private static final String STORE_PROP = "vendor.timekeep.store";
 	private static final String RTC_SINCE_EPOCH = "/sys/class/rtc/rtc0/since_epoch";
-	private static final String RTC_ATS_FILE = "/data/vendor/time/ats_2";
 
 	@Override
 	public void onReceive(Context context, Intent intent) {
@@ -64,9 +61,12 @@ public class TimeKeep extends BroadcastReceiver {
 
 		String currentAdjust = SystemProperties.get(TIMEADJ_PROP);
 
+		// Only read by timekeep restore until the first journal record exists
 		Log.d(TAG, "Setting adjust property to " + seconds);
 		SystemProperties.set(TIMEADJ_PROP, Long.toString(seconds));
-		writeATS(seconds);
+
+		// timekeep store journals the offset and writes ats_2 in milliseconds
+		SystemProperties.set(STORE_PROP, Long.toString(SystemClock.elapsedRealtime()));
 	}
 
 	private long readEpoch() {
@@ -89,29 +89,4 @@ public class TimeKeep extends BroadcastReceiver {
 
 		return epoch;
 	}
-
-	private void writeATS(long seconds) {
-		BufferedOutputStream bos = null;
-		long milliseconds = seconds * 1000;
-		ByteBuffer buffer = ByteBuffer.allocate(8).order(ByteOrder.nativeOrder());
-		buffer.putLong(milliseconds);
-		try {
-			bos = new BufferedOutputStream(new FileOutputStream(RTC_ATS_FILE, false));
-			bos.write(buffer.array());
-			bos.flush();
-		} catch (FileNotFoundException ex) {
-			Log.w(TAG, "file " + RTC_ATS_FILE + " not found: " + ex);
-		} catch (IOException ex) {
-			Log.w(TAG, "IOException trying to sync " + RTC_ATS_FILE + ": " + ex);
-		} finally {
-			if (bos != null) {
-				try {
-					Log.w(TAG, "file " + RTC_ATS_FILE + ": " + milliseconds);
-					bos.close();
-				} catch (IOException ex) {
-					Log.w(TAG, "IOException while closing synced file: ", ex);
-				}
-			}
-		}
-	}
 }
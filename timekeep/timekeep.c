@@ -30,12 +30,20 @@
  */
 
 #include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <poll.h>
+#include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
 #include <time.h>
 
 #define LOG_TAG "TimeKeep"
@@ -46,39 +54,293 @@
 
 #define RTC_SYS_FILE "/sys/class/rtc/rtc0/since_epoch"
 #define RTC_ATS_FILE "/data/vendor/time/ats_2"
+#define RTC_JOURNAL_DIR "/data/vendor/time"
+#define RTC_JOURNAL_FILE RTC_JOURNAL_DIR "/journal"
+#define RTC_JOURNAL_TMP_FILE RTC_JOURNAL_FILE ".tmp"
+#define RTC_JOURNAL_LOCK_FILE RTC_JOURNAL_DIR "/journal.lock"
 #define TIME_ADJUST_PROP "persist.vendor.timeadjust"
 
-int read_epoch(unsigned long long* epoch) {
-	int res = 0;
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_MSEC 1000000LL
 
-	int fd = open(RTC_SYS_FILE, O_RDONLY);
-	if (fd == -1) {
+/*
+ * The journal is an append-only array of fixed size records. Once it grows
+ * past JOURNAL_MAX_RECORDS it is rewritten with only the newest
+ * JOURNAL_KEEP_RECORDS. A torn record at the tail fails its check and is
+ * ignored.
+ */
+#define JOURNAL_MAGIC 0x4a4b5454 /* "TTKJ" */
+#define JOURNAL_MAX_RECORDS 512
+#define JOURNAL_KEEP_RECORDS 64
+
+/*
+ * Records are only fdatasync'ed every JOURNAL_SYNC_BATCH appends, unless
+ * the offset moved by more than JOURNAL_SYNC_OFFSET_NS, i.e. the clock
+ * was really set rather than just re-stored.
+ */
+#define JOURNAL_SYNC_BATCH 8
+#define JOURNAL_SYNC_OFFSET_NS (NSEC_PER_SEC / 2)
+
+/* The RTC counts whole seconds; its edges are found by polling this often. */
+#define RTC_EDGE_POLL_NS (2 * NSEC_PER_MSEC)
+#define RTC_EDGE_TIMEOUT_NS (1100 * NSEC_PER_MSEC)
+
+/*
+ * In watch mode, clock sets arriving closer together than this (NITZ
+ * followed by NTP, a user dragging the clock) are stored once.
+ */
+#define WATCH_SETTLE_MS 2000
+
+/*
+ * The kernel also cancels clock set timers on every resume from suspend.
+ * CLOCK_REALTIME - CLOCK_BOOTTIME survives suspend unchanged, so unless it
+ * moved by more than this the clock was not really set.
+ */
+#define WATCH_SET_THRESHOLD_NS (10 * NSEC_PER_MSEC)
+
+/* Drift beyond this is not crystal error but a clock set. */
+#define MAX_DRIFT_PPM 500
+/* Samples spanning less than this are too close together to fit a drift. */
+#define MIN_DRIFT_SPAN_S 3600
+
+struct journal_record {
+	uint32_t magic;
+	uint32_t check;
+	uint64_t rtc_epoch;   /* RTC seconds, sampled on the tick */
+	int64_t wall_ns;      /* CLOCK_REALTIME at that tick */
+	int64_t boottime_ns;  /* CLOCK_BOOTTIME at that tick */
+};
+
+static int64_t clock_ns(clockid_t clock) {
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+int read_epoch(int fd, unsigned long long* epoch) {
+	char buffer[16];
+	int res;
+
+	memset(buffer, 0, 16);
+	res = pread(fd, buffer, 15, 0);
+	if (res > 0) {
+		char *endp = NULL;
+		*epoch = strtoull(buffer, &endp, 10);
+		// sysfs read returns newline, ok to end up at '\n'
+		if (*endp != '\0' && *endp != '\n') {
+			ALOGI("Read from " RTC_SYS_FILE " returned "
+			      "invalid string %s (%s)", buffer, endp);
+			res = -1;
+		}
+	} else if (res < 0) {
 		res = -errno;
+	}
+
+	return res;
+}
+
+/*
+ * Waits for the RTC to tick over to the next second, so that the returned
+ * epoch is exact at the returned boottime, to within RTC_EDGE_POLL_NS.
+ */
+int wait_rtc_edge(unsigned long long* epoch, int64_t* boottime_ns) {
+	struct timespec poll_ts = { 0, RTC_EDGE_POLL_NS };
+	unsigned long long start, now;
+	int64_t deadline, before;
+	int res;
+
+	int fd = open(RTC_SYS_FILE, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
 		ALOGD("Failed to open RTC sys path");
-	} else {
-		char buffer[16];
-		memset(buffer, 0, 16);
-		res = read(fd, buffer, 16);
-		if (res > 0) {
-			char *endp = NULL;
-			*epoch = strtoull(buffer, &endp, 10);
-			// sysfs read returns newline, ok to end up at '\n'
-			if (*endp != '\0' && *endp != '\n') {
-				ALOGI("Read from " RTC_SYS_FILE " returned "
-				      "invalid string %s (%s)", buffer, endp);
-				res = -1;
-			}
+		return -errno;
+	}
+
+	res = read_epoch(fd, &start);
+	deadline = clock_ns(CLOCK_BOOTTIME) + RTC_EDGE_TIMEOUT_NS;
+	while (res > 0) {
+		before = clock_ns(CLOCK_BOOTTIME);
+		res = read_epoch(fd, &now);
+		if (res > 0 && now != start) {
+			*epoch = now;
+			/* The tick happened between the two reads. */
+			*boottime_ns = before + (clock_ns(CLOCK_BOOTTIME) - before) / 2 -
+				       RTC_EDGE_POLL_NS / 2;
+			break;
+		}
+		if (before > deadline) {
+			ALOGI("RTC did not tick, is it running?");
+			res = -ETIMEDOUT;
+			break;
 		}
+		nanosleep(&poll_ts, NULL);
+	}
+
+	close(fd);
+	return res > 0 ? 0 : (res < 0 ? res : -EIO);
+}
+
+static uint32_t record_check(const struct journal_record *rec) {
+	const uint32_t *words = (const uint32_t *)&rec->rtc_epoch;
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < (sizeof(*rec) - offsetof(struct journal_record, rtc_epoch)) / 4; i++)
+		hash = (hash ^ words[i]) * 16777619u;
+	return hash;
+}
+
+static int64_t record_offset(const struct journal_record *rec) {
+	return rec->wall_ns - (int64_t)rec->rtc_epoch * NSEC_PER_SEC;
+}
+
+/*
+ * Loads the journal into recs, oldest first, and returns how many records
+ * are valid. *clean is cleared when the file holds anything else, such as
+ * a torn write, so that the next append rewrites it.
+ */
+static int journal_load(struct journal_record recs[JOURNAL_MAX_RECORDS], bool *clean) {
+	int fd, n = 0;
+	ssize_t len;
+
+	*clean = true;
+	fd = open(RTC_JOURNAL_FILE, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return 0;
+
+	len = read(fd, recs, JOURNAL_MAX_RECORDS * sizeof(*recs));
+	close(fd);
+
+	while (n < len / (ssize_t)sizeof(*recs) && recs[n].magic == JOURNAL_MAGIC &&
+	       recs[n].check == record_check(&recs[n]))
+		n++;
+	if (len != (ssize_t)(n * sizeof(*recs)))
+		*clean = false;
+
+	return n;
+}
+
+/* Makes a rename() in dir durable. */
+static int sync_dir(const char *dir) {
+	int fd, res = 0;
+
+	fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+		return -errno;
+	if (fsync(fd) != 0)
+		res = -errno;
+	close(fd);
+
+	return res;
+}
+
+static int journal_compact(const struct journal_record *recs, int n) {
+	int fd, res = 0;
+	size_t len = n * sizeof(*recs);
+
+	fd = open(RTC_JOURNAL_TMP_FILE, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+	if (fd == -1) {
+		ALOGI("Can't create " RTC_JOURNAL_TMP_FILE);
+		return -errno;
+	}
+
+	if (write(fd, recs, len) != (ssize_t)len || fsync(fd) != 0)
+		res = -errno;
+	close(fd);
+
+	if (res == 0 && rename(RTC_JOURNAL_TMP_FILE, RTC_JOURNAL_FILE) != 0)
+		res = -errno;
+	if (res == 0)
+		res = sync_dir(RTC_JOURNAL_DIR);
+	if (res != 0)
+		ALOGI("Failed to compact " RTC_JOURNAL_FILE " (%d)", res);
+
+	return res;
+}
+
+static int journal_append(struct journal_record recs[JOURNAL_MAX_RECORDS], int n, bool clean,
+			  const struct journal_record *rec) {
+	bool sync;
+	int fd, res = 0;
+
+	if (n == JOURNAL_MAX_RECORDS) {
+		memmove(recs, recs + n - (JOURNAL_KEEP_RECORDS - 1),
+			(JOURNAL_KEEP_RECORDS - 1) * sizeof(*recs));
+		recs[JOURNAL_KEEP_RECORDS - 1] = *rec;
+		return journal_compact(recs, JOURNAL_KEEP_RECORDS);
+	}
+	if (!clean) {
+		recs[n] = *rec;
+		return journal_compact(recs, n + 1);
+	}
+
+	sync = n == 0 || (n + 1) % JOURNAL_SYNC_BATCH == 0 ||
+	       llabs(record_offset(rec) - record_offset(&recs[n - 1])) > JOURNAL_SYNC_OFFSET_NS;
+
+	fd = open(RTC_JOURNAL_FILE, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0660);
+	if (fd == -1) {
+		ALOGI("Can't open " RTC_JOURNAL_FILE);
+		return -errno;
+	}
+
+	if (write(fd, rec, sizeof(*rec)) != sizeof(*rec) || (sync && fdatasync(fd) != 0)) {
+		res = -errno;
+		ALOGI("Failed to append to " RTC_JOURNAL_FILE " (%d)", res);
 	}
+	close(fd);
 
 	return res;
 }
 
-/* ats_2 contains the time offset as 8-byte binary representation */
+/*
+ * Predicts the wall clock offset at RTC time rtc_now. Walking back from the
+ * newest record, samples whose offsets differ by no more than the maximum
+ * crystal drift belong to the same setting of the clock; a least squares
+ * line through them gives the RTC's drift, which is extrapolated.
+ */
+int64_t estimate_offset(const struct journal_record *recs, int n, unsigned long long rtc_now) {
+	const struct journal_record *last = &recs[n - 1];
+	double sx = 0, sy = 0, sxx = 0, sxy = 0, drift = 0;
+	int first = n - 1;
+
+	while (first > 0) {
+		const struct journal_record *a = &recs[first - 1], *b = &recs[first];
+		int64_t span = (int64_t)(b->rtc_epoch - a->rtc_epoch);
+		int64_t allowed = span * MAX_DRIFT_PPM * 1000 + NSEC_PER_SEC / 10;
+
+		if (b->rtc_epoch < a->rtc_epoch ||
+		    llabs(record_offset(b) - record_offset(a)) > allowed)
+			break;
+		first--;
+	}
+
+	if (last->rtc_epoch - recs[first].rtc_epoch >= MIN_DRIFT_SPAN_S) {
+		int count = n - first;
+
+		/* Relative to the newest sample, so the doubles keep ns precision. */
+		for (int i = first; i < n; i++) {
+			double x = (double)recs[i].rtc_epoch - (double)last->rtc_epoch;
+			double y = (double)(record_offset(&recs[i]) - record_offset(last));
+
+			sx += x;
+			sy += y;
+			sxx += x * x;
+			sxy += x * y;
+		}
+		drift = (count * sxy - sx * sy) / (count * sxx - sx * sx);
+		if (drift > MAX_DRIFT_PPM * 1000.0)
+			drift = MAX_DRIFT_PPM * 1000.0;
+		if (drift < -MAX_DRIFT_PPM * 1000.0)
+			drift = -MAX_DRIFT_PPM * 1000.0;
+		ALOGI("RTC drift %.2f ppm over %d samples", drift / 1000.0, count);
+	}
+
+	return record_offset(last) + (int64_t)(drift * ((double)rtc_now - (double)last->rtc_epoch));
+}
+
+/* ats_2 contains the time offset in milliseconds as 8-byte binary representation */
 void restore_ats(uint64_t value) {
 	FILE *fp = NULL;
 
-	value *= 1000;
 	fp = fopen(RTC_ATS_FILE, "wb");
 
 	if (fp != NULL) {
@@ -90,37 +352,48 @@ void restore_ats(uint64_t value) {
 }
 
 int store_time() {
-	char prop[PROPERTY_VALUE_MAX];
-	unsigned long long seconds = 0;
-	unsigned long long epoch_since = 0;
-	int res = -1;
-	struct tm tm;
-	time_t t;
+	struct journal_record recs[JOURNAL_MAX_RECORDS];
+	struct journal_record rec;
+	unsigned long long epoch = 0;
+	int64_t boottime = 0;
+	bool clean;
+	int lock_fd, n, res;
 
-	// Get time and adjust for local time
-	time(&t);
-	localtime_r(&t, &tm);
-	seconds = mktime(&tm);
+	res = wait_rtc_edge(&epoch, &boottime);
+	if (res < 0) {
+		ALOGI("Failed to read epoch while storing");
+		return res;
+	}
 
-	if (seconds > 0) {
-		res = read_epoch(&epoch_since);
-		if (res < 0) {
-			ALOGI("Failed to read epoch while storing");
-		} else {
-			seconds -= epoch_since;
-			snprintf(prop, PROPERTY_VALUE_MAX, "%llu", seconds);
-			restore_ats(seconds);
-			property_set(TIME_ADJUST_PROP, prop);
-			ALOGI("Time adjustment stored to property");
-			res = 0;
-		}
+	rec.magic = JOURNAL_MAGIC;
+	rec.rtc_epoch = epoch;
+	rec.boottime_ns = boottime;
+	rec.wall_ns = clock_ns(CLOCK_REALTIME) - (clock_ns(CLOCK_BOOTTIME) - boottime);
+	rec.check = record_check(&rec);
+
+	/* The watch daemon and timekeep_store may both be storing. */
+	lock_fd = open(RTC_JOURNAL_LOCK_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0660);
+	if (lock_fd == -1 || TEMP_FAILURE_RETRY(flock(lock_fd, LOCK_EX)) != 0) {
+		res = -errno;
+		ALOGI("Can't lock " RTC_JOURNAL_LOCK_FILE " (%d)", res);
+		if (lock_fd != -1)
+			close(lock_fd);
+		return res;
 	}
 
+	n = journal_load(recs, &clean);
+	res = journal_append(recs, n, clean, &rec);
+	if (res == 0) {
+		restore_ats(record_offset(&rec) / NSEC_PER_MSEC);
+		ALOGI("Time adjustment stored to journal");
+	}
+	close(lock_fd);
+
 	return res;
 }
 
-
-int restore_time() {
+/* Restores from the property written by older versions, before any journal exists. */
+int restore_time_legacy() {
 	struct timeval tv;
 	unsigned long long time_adjust = 0;
 	unsigned long long epoch_since = 0;
@@ -142,12 +415,16 @@ int restore_time() {
 		return res;
 	}
 
-	res = read_epoch(&epoch_since);
-	if (res < 0) {
+	int fd = open(RTC_SYS_FILE, O_RDONLY | O_CLOEXEC);
+	res = fd == -1 ? -errno : read_epoch(fd, &epoch_since);
+	if (fd != -1)
+		close(fd);
+	if (res <= 0) {
 		ALOGI("Failed to read from " RTC_SYS_FILE
 		      " (%d), bailing out", res);
+		res = -1;
 	} else {
-		restore_ats(time_adjust);
+		restore_ats(time_adjust * 1000);
 		tv.tv_sec = epoch_since + time_adjust;
 		tv.tv_usec = 0;
 		res = settimeofday(&tv, NULL);
@@ -162,10 +439,128 @@ int restore_time() {
 	return res;
 }
 
+int restore_time() {
+	struct journal_record recs[JOURNAL_MAX_RECORDS];
+	unsigned long long epoch = 0;
+	int64_t boottime = 0, offset, wall;
+	struct timespec ts;
+	bool clean;
+	int n, res;
+
+	n = journal_load(recs, &clean);
+	if (n == 0)
+		return restore_time_legacy();
+
+	res = wait_rtc_edge(&epoch, &boottime);
+	if (res < 0) {
+		ALOGI("Failed to read from " RTC_SYS_FILE
+		      " (%d), bailing out", res);
+		return res;
+	}
+
+	offset = estimate_offset(recs, n, epoch);
+	wall = (int64_t)epoch * NSEC_PER_SEC + offset + (clock_ns(CLOCK_BOOTTIME) - boottime);
+	if (wall <= 0) {
+		ALOGI("Journal offset is not valid: %" PRId64, offset);
+		return -1;
+	}
+
+	restore_ats(offset / NSEC_PER_MSEC);
+	ts.tv_sec = wall / NSEC_PER_SEC;
+	ts.tv_nsec = wall % NSEC_PER_SEC;
+	res = clock_settime(CLOCK_REALTIME, &ts);
+	if (res != 0) {
+		ALOGI("Failed to restore time (%d), root?",
+		      res);
+	} else {
+		ALOGI("Time restored!");
+	}
+
+	return res;
+}
+
+/*
+ * Arms fd far in the future with TFD_TIMER_CANCEL_ON_SET, so that it only
+ * becomes readable, failing with ECANCELED, when CLOCK_REALTIME is set.
+ */
+static int arm_clock_set_timer(int fd) {
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	clock_gettime(CLOCK_REALTIME, &its.it_value);
+	its.it_value.tv_sec += 365 * 24 * 3600;
+
+	return timerfd_settime(fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL);
+}
+
+/* Returns 1 if the clock was set, 0 if the timer merely expired, or -errno. */
+static int read_clock_set_timer(int fd) {
+	uint64_t expirations;
+
+	if (read(fd, &expirations, sizeof(expirations)) >= 0)
+		return 0;
+	return errno == ECANCELED ? 1 : -errno;
+}
+
+static int64_t realtime_base(void) {
+	return clock_ns(CLOCK_REALTIME) - clock_ns(CLOCK_BOOTTIME);
+}
+
+/*
+ * Stores the offset every time the wall clock is set. Resumes wake the
+ * loop as well, but only cost a clock read.
+ */
+int watch_time() {
+	struct pollfd pfd;
+	int64_t stored_base, base;
+	int res;
+
+	pfd.fd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+	pfd.events = POLLIN;
+	if (pfd.fd == -1 || arm_clock_set_timer(pfd.fd) != 0) {
+		ALOGE("Failed to create clock set timer (%d)", errno);
+		return -1;
+	}
+	stored_base = realtime_base();
+
+	while (1) {
+		res = read_clock_set_timer(pfd.fd);
+		arm_clock_set_timer(pfd.fd);
+		if (res == -EINTR || res == 0)
+			continue;
+		if (res < 0) {
+			ALOGE("Clock set timer failed (%d)", res);
+			break;
+		}
+
+		/* A resume, not a set: go back to sleep. */
+		if (llabs(realtime_base() - stored_base) <= WATCH_SET_THRESHOLD_NS)
+			continue;
+
+		/* Let a burst of sets settle, then store the final clock once. */
+		while ((res = poll(&pfd, 1, WATCH_SETTLE_MS)) != 0) {
+			if (res > 0) {
+				read_clock_set_timer(pfd.fd);
+				arm_clock_set_timer(pfd.fd);
+			} else if (errno != EINTR) {
+				break;
+			}
+		}
+
+		base = realtime_base();
+		ALOGI("Wall clock was set");
+		if (store_time() == 0)
+			stored_base = base;
+	}
+
+	close(pfd.fd);
+	return -1;
+}
+
 int main(int argc, char* argv[]) {
 	int res = -1;
 	if (argc != 2) {
-		ALOGI("usage: timekeep store|restore");
+		ALOGI("usage: timekeep store|restore|watch");
 		return res;
 	}
 
@@ -179,5 +574,9 @@ int main(int argc, char* argv[]) {
 		res = restore_time();
 	}
 
+	if (strcmp(argv[1], "watch") == 0) {
+		res = watch_time();
+	}
+
 	return res;
 }